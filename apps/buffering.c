@@ -44,6 +44,12 @@
 
 #define BUF_MAX_HANDLES 384
 
+/* Number of buckets in the handle ID hash table; must be a power of 2.
+   IDs are handed out sequentially so the live handles spread evenly over
+   the buckets and chains stay short no matter how many handles exist. */
+#define BUF_HANDLE_HASH_SIZE 256
+#define BUF_HANDLE_HASH(id) ((unsigned int)(id) & (BUF_HANDLE_HASH_SIZE-1))
+
 /* macros to enable logf for queues
    logging on SYS_TIMEOUT can be disabled */
 #ifdef SIMULATOR
@@ -67,8 +73,31 @@
 
 #define GUARD_BUFSIZE   (32*1024)
 
-/* amount of data to read in one read() call */
+/* amount of data to read in one read() call; this is the starting and
+   smallest size and it grows up to the maximum with storage throughput
+   (see filechunk_update()) */
 #define BUFFERING_DEFAULT_FILECHUNK      (1024*32)
+#if MEMORYSIZE > 8
+#define BUFFERING_MAX_FILECHUNK          (1024*512)
+#elif MEMORYSIZE > 2
+#define BUFFERING_MAX_FILECHUNK          (1024*128)
+#else
+#define BUFFERING_MAX_FILECHUNK          BUFFERING_DEFAULT_FILECHUNK
+#endif
+
+/* Read time aimed for by one chunk; bounds the latency of handling queue
+   messages while filling */
+#define BUFFERING_FILECHUNK_TICKS        (HZ/20)
+
+/* Let the OS start reading the next chunk in the background while the
+   current one is accounted for */
+#if defined(APPLICATION) && defined(POSIX_FADV_WILLNEED)
+#define buffering_readahead(fd, pos, len) \
+    posix_fadvise((fd), (pos), (len), POSIX_FADV_WILLNEED)
+#else
+#define buffering_readahead(fd, pos, len) \
+    do {} while (0)
+#endif
 
 enum handle_flags
 {
@@ -79,7 +108,7 @@ enum handle_flags
 
 struct memory_handle {
     struct lld_node hnode;  /* Handle list node (first!) */
-    struct lld_node mrunode;/* MRU list node (second!) */
+    struct lld_node hashnode;/* ID hash chain node (second!) */
     size_t  size;           /* Size of this structure + its auxilliary data */
     int     id;             /* A unique ID for the handle */
     enum data_type type;    /* Type of data buffered with this handle */
@@ -116,7 +145,7 @@ static size_t conf_watermark = 0; /* Level to trigger filebuf fill */
 static size_t high_watermark = 0; /* High watermark for rebuffer */
 
 static struct lld_head handle_list; /* buffer-order handle list */
-static struct lld_head mru_cache;   /* MRU-ordered list of handles */
+static struct lld_head handle_hash[BUF_HANDLE_HASH_SIZE]; /* ID lookup */
 static int num_handles;             /* number of handles in the lists */
 static int base_handle_id;
 
@@ -139,8 +168,27 @@ static struct mutex llist_mutex SHAREDBSS_ATTR;
 #define HLIST_NEXT(h) \
     HLIST_HANDLE((h)->hnode.next)
 
-#define MRU_HANDLE(m) \
-    container_of((m), struct memory_handle, mrunode)
+#define HASH_HANDLE(m) \
+    container_of((m), struct memory_handle, hashnode)
+
+#define HASH_BUCKET(id) \
+    (&handle_hash[BUF_HANDLE_HASH(id)])
+
+/* Handle lookup statistics for the debug screen */
+static struct lookup_counters
+{
+    unsigned long lookups; /* Number of find_handle() calls */
+    unsigned long steps;   /* Total hash chain nodes examined */
+    int max_steps;         /* Longest chain walk seen */
+} lookup_counters;
+
+/* Storage throughput tracking for sizing reads */
+static struct filechunk_data
+{
+    size_t size;        /* Current read size */
+    size_t bytes;       /* Bytes read in the measuring window */
+    long ticks;         /* Ticks spent inside read() in the window */
+} filechunk = { .size = BUFFERING_DEFAULT_FILECHUNK };
 
 static struct data_counters
 {
@@ -283,8 +331,8 @@ num_handles = N
 head=> --------^                          ^
 tail=> -----------------------------------+
 
-MRU cache is similar except new handles are added at the head and the most-
-recently-accessed handle is always moved to the head (if not already there).
+Each handle is also linked into the hash chain selected by its ID so that
+find_handle doesn't depend on the number of handles in the buffer.
 
 */
 
@@ -305,7 +353,7 @@ static int next_handle_id(void)
 static void link_handle(struct memory_handle *h)
 {
     lld_insert_last(&handle_list, &h->hnode);
-    lld_insert_first(&mru_cache, &h->mrunode);
+    lld_insert_first(HASH_BUCKET(h->id), &h->hashnode);
     num_handles++;
 }
 
@@ -313,7 +361,7 @@ static void link_handle(struct memory_handle *h)
 static void unlink_handle(struct memory_handle *h)
 {
     lld_remove(&handle_list, &h->hnode);
-    lld_remove(&mru_cache, &h->mrunode);
+    lld_remove(HASH_BUCKET(h->id), &h->hashnode);
     num_handles--;
 }
 
@@ -429,24 +477,20 @@ add_handle(unsigned int flags, size_t data_size, const char *path,
    NULL if the handle wasn't found */
 static struct memory_handle * find_handle(int handle_id)
 {
-    struct memory_handle *h = NULL;
-    struct lld_node *mru = mru_cache.head;
-    struct lld_node *m = mru;
+    struct lld_node *m = HASH_BUCKET(handle_id)->head;
+    int steps = 1;
 
-    while (m && MRU_HANDLE(m)->id != handle_id) {
+    while (m && HASH_HANDLE(m)->id != handle_id) {
         m = m->next;
+        steps++;
     }
 
-    if (m) {
-        if (m != mru) {
-            lld_remove(&mru_cache, m);
-            lld_insert_first(&mru_cache, m);
-        }
-
-        h = MRU_HANDLE(m);
-    }
+    lookup_counters.lookups++;
+    lookup_counters.steps += steps;
+    if (steps > lookup_counters.max_steps)
+        lookup_counters.max_steps = steps;
 
-    return h;
+    return m ? HASH_HANDLE(m) : NULL;
 }
 
 /* Move a memory handle and data_size of its data delta bytes along the buffer.
@@ -513,7 +557,7 @@ static bool move_handle(struct memory_handle **h, size_t *delta,
 
     /* Adjust list pointers */
     adjust_handle_node(&handle_list, &src->hnode, &dest->hnode);
-    adjust_handle_node(&mru_cache, &src->mrunode, &dest->mrunode);
+    adjust_handle_node(HASH_BUCKET(src->id), &src->hashnode, &dest->hashnode);
 
     /* x = handle(s) following this one...
      * ...if last handle, unmoveable if metadata, only shrinkable if audio.
@@ -619,6 +663,38 @@ static int update_data_counters(struct data_counters *dc)
     return num;
 }
 
+/* Account a completed read and retune the chunk size once enough has been
+   measured: double it while a chunk reads in well under the target time
+   and halve it when reads take longer */
+static void filechunk_update(size_t bytes, long ticks)
+{
+    filechunk.bytes += bytes;
+    filechunk.ticks += ticks;
+
+    if (filechunk.ticks < 4*BUFFERING_FILECHUNK_TICKS &&
+        filechunk.bytes < 8*filechunk.size)
+        return;
+
+    /* bytes readable in the target time at the measured rate */
+    size_t target = (uint64_t)filechunk.bytes * BUFFERING_FILECHUNK_TICKS /
+                        MAX(filechunk.ticks, 1);
+    size_t size = filechunk.size;
+
+    if (target >= 2*size && size < BUFFERING_MAX_FILECHUNK)
+        size *= 2;
+    else if (target < size && size > BUFFERING_DEFAULT_FILECHUNK)
+        size /= 2;
+
+    if (size != filechunk.size)
+        logf("filechunk: %lu", (unsigned long)size);
+
+    filechunk.size = size;
+
+    /* Keep some history so a single odd read doesn't swing it */
+    filechunk.bytes /= 2;
+    filechunk.ticks /= 2;
+}
+
 /* Q_BUFFER_HANDLE event and buffer data for the given handle.
    Return whether or not the buffering should continue explicitly.  */
 static bool buffer_handle(int handle_id, size_t to_buffer)
@@ -667,7 +743,7 @@ static bool buffer_handle(int handle_id, size_t to_buffer)
         /* max amount to copy */
         size_t widx = h->widx;
         ssize_t copy_n = h->filesize - h->end;
-        copy_n = MIN(copy_n, BUFFERING_DEFAULT_FILECHUNK);
+        copy_n = MIN(copy_n, (ssize_t)filechunk.size);
         copy_n = MIN(copy_n, (off_t)(buffer_len - widx));
 
         mutex_lock(&llist_mutex);
@@ -688,7 +764,11 @@ static bool buffer_handle(int handle_id, size_t to_buffer)
         if (copy_n <= 0)
             return false; /* no space for read */
 
+        if (!stop && h->end + copy_n < h->filesize)
+            buffering_readahead(h->fd, h->end + copy_n, filechunk.size);
+
         /* rc is the actual amount read */
+        long tick = current_tick;
         ssize_t rc = read(h->fd, ringbuf_ptr(widx), copy_n);
 
         if (rc <= 0) {
@@ -704,6 +784,8 @@ static bool buffer_handle(int handle_id, size_t to_buffer)
             break;
         }
 
+        filechunk_update(rc, current_tick - tick);
+
         /* Advance buffer and make data available to users */
         h->widx = ringbuf_add(widx, rc);
         h->end += rc;
@@ -848,11 +930,11 @@ static int load_image(int fd, const char *path,
                       struct bufopen_bitmap_data *data,
                       size_t bufidx, size_t max_size)
 {
-    (void)path;
     int rc;
     struct bitmap *bmp = ringbuf_ptr(bufidx);
     struct dim *dim = data->dim;
     struct mp3_albumart *aa = data->embedded_albumart;
+    struct albumart_cache_key key;
 
     /* get the desired image size */
     bmp->width = dim->width, bmp->height = dim->height;
@@ -862,6 +944,17 @@ static int load_image(int fd, const char *path,
 #if (LCD_DEPTH > 1) || defined(HAVE_REMOTE_LCD) && (LCD_REMOTE_DEPTH > 1)
     bmp->maskdata = NULL;
 #endif
+
+    /* Already scaled for this size? */
+    bool cacheable = albumart_cache_get_key(fd, path, aa, dim, &key);
+    if (cacheable)
+    {
+        rc = albumart_cache_load(&key, bmp, max_size - sizeof(struct bitmap));
+        if (rc > 0)
+            return rc + sizeof(struct bitmap);
+        bmp->width = dim->width, bmp->height = dim->height;
+    }
+
     const int format = FORMAT_NATIVE | FORMAT_DITHER |
                        FORMAT_RESIZE | FORMAT_KEEP_ASPECT;
 #ifdef HAVE_JPEG
@@ -875,6 +968,9 @@ static int load_image(int fd, const char *path,
 #endif
         rc = read_bmp_fd(fd, bmp, (int)max_size, format, NULL);
 
+    if (rc > 0 && cacheable)
+        albumart_cache_store(&key, bmp, rc);
+
     return rc + (rc > 0 ? sizeof(struct bitmap) : 0);
 }
 #endif /* HAVE_ALBUMART */
@@ -1712,7 +1808,8 @@ bool buffering_reset(char *buf, size_t buflen)
     guard_buffer = buf + buflen;
 
     lld_init(&handle_list);
-    lld_init(&mru_cache);
+    for (int i = 0; i < BUF_HANDLE_HASH_SIZE; i++)
+        lld_init(&handle_hash[i]);
 
     num_handles = 0;
     base_handle_id = -1;
@@ -1738,4 +1835,8 @@ void buffering_get_debugdata(struct buffering_debug *dbgdata)
     dbgdata->buffered_data = dc.buffered;
     dbgdata->useful_data = dc.useful;
     dbgdata->watermark = BUF_WATERMARK;
+    dbgdata->lookups = lookup_counters.lookups;
+    dbgdata->lookup_steps = lookup_counters.steps;
+    dbgdata->lookup_max_steps = lookup_counters.max_steps;
+    dbgdata->filechunk = filechunk.size;
 }
@@ -120,6 +120,10 @@ struct buffering_debug {
     size_t data_rem;
     size_t useful_data;
     size_t watermark;
+    unsigned long lookups;      /* handle lookups performed */
+    unsigned long lookup_steps; /* hash chain nodes examined by lookups */
+    int lookup_max_steps;       /* longest single lookup */
+    size_t filechunk;           /* current read size */
 };
 void buffering_get_debugdata(struct buffering_debug *dbgdata);
 
@@ -31,6 +31,7 @@
 #include "playback.h"
 #include "buffering.h"
 #include "dsp_core.h"
+#include "dsp_misc.h"
 #include "metadata.h"
 #include "settings.h"
 
@@ -511,6 +512,12 @@ static void run_codec(void)
 
     trigger_cpu_boost();
     dsp_configure(ci.dsp, DSP_SET_OUT_FREQUENCY, pcmbuf_get_frequency());
+#ifdef HAVE_PCM_HIRES
+    /* pcmbuf holds high-resolution frames; any other user of the audio
+       DSP gets 16-bit output back with DSP_RESET */
+    if (!encoder)
+        dsp_set_output_depth(PCM_HIRES_DEPTH);
+#endif
 
     if (!encoder)
     {
@@ -50,6 +50,9 @@
 #include "splash.h"
 #include "general.h"
 #include "rbpaths.h"
+#ifdef HAVE_SDL_THREADS
+#include "thread-sdl.h"
+#endif
 
 #define LOGF_ENABLE
 #include "logf.h"
@@ -177,6 +180,214 @@ void *codec_get_buffer_callback(size_t *size)
 static void *curr_handle = NULL;
 static struct codec_header *c_hdr = NULL;
 
+#ifdef HAVE_SDL_THREADS
+/* With --parallelcodec a decoder's own code runs outside the lock that
+ * serializes the simulated threads, so decoding overlaps with the UI,
+ * buffering and the DSP on a multicore host. The core isn't reentrant,
+ * so every call the codec makes back into it takes the lock again for
+ * its duration; pcmbuf_insert and the buffer calls are the handoffs. */
+static struct codec_api ci_locked; /* the callbacks being wrapped */
+static void *codec_unlocked_self;  /* set while codec code runs unlocked */
+
+static inline void *codec_lock(void)
+{
+    void *self = codec_unlocked_self;
+
+    if (self) {
+        codec_unlocked_self = NULL;
+        sim_thread_lock(self);
+    }
+
+    return self;
+}
+
+static inline void codec_unlock(void *self)
+{
+    if (self)
+        codec_unlocked_self = sim_thread_unlock();
+}
+
+static void *codec_get_buffer_unlocked(size_t *size)
+{
+    void *self = codec_lock();
+    void *buf = ci_locked.codec_get_buffer(size);
+    codec_unlock(self);
+    return buf;
+}
+
+static void pcmbuf_insert_unlocked(const void *ch1, const void *ch2,
+                                   int count)
+{
+    void *self = codec_lock();
+    ci_locked.pcmbuf_insert(ch1, ch2, count);
+    codec_unlock(self);
+}
+
+static void set_elapsed_unlocked(unsigned long value)
+{
+    void *self = codec_lock();
+    ci_locked.set_elapsed(value);
+    codec_unlock(self);
+}
+
+static size_t read_filebuf_unlocked(void *ptr, size_t size)
+{
+    void *self = codec_lock();
+    size_t rc = ci_locked.read_filebuf(ptr, size);
+    codec_unlock(self);
+    return rc;
+}
+
+static void *request_buffer_unlocked(size_t *realsize, size_t reqsize)
+{
+    void *self = codec_lock();
+    void *buf = ci_locked.request_buffer(realsize, reqsize);
+    codec_unlock(self);
+    return buf;
+}
+
+static void advance_buffer_unlocked(size_t amount)
+{
+    void *self = codec_lock();
+    ci_locked.advance_buffer(amount);
+    codec_unlock(self);
+}
+
+static bool seek_buffer_unlocked(size_t newpos)
+{
+    void *self = codec_lock();
+    bool rc = ci_locked.seek_buffer(newpos);
+    codec_unlock(self);
+    return rc;
+}
+
+static void seek_complete_unlocked(void)
+{
+    void *self = codec_lock();
+    ci_locked.seek_complete();
+    codec_unlock(self);
+}
+
+static void set_offset_unlocked(size_t value)
+{
+    void *self = codec_lock();
+    ci_locked.set_offset(value);
+    codec_unlock(self);
+}
+
+static void configure_unlocked(int setting, intptr_t value)
+{
+    void *self = codec_lock();
+    ci_locked.configure(setting, value);
+    codec_unlock(self);
+}
+
+static long get_command_unlocked(intptr_t *param)
+{
+    void *self = codec_lock();
+    long action = ci_locked.get_command(param);
+    codec_unlock(self);
+    return action;
+}
+
+static bool loop_track_unlocked(void)
+{
+    void *self = codec_lock();
+    bool rc = ci_locked.loop_track();
+    codec_unlock(self);
+    return rc;
+}
+
+static unsigned sleep_unlocked(unsigned ticks)
+{
+    void *self = codec_lock();
+    unsigned rc = ci_locked.sleep(ticks);
+    codec_unlock(self);
+    return rc;
+}
+
+static void yield_unlocked(void)
+{
+    void *self = codec_lock();
+    ci_locked.yield();
+    codec_unlock(self);
+}
+
+#ifdef ROCKBOX_HAS_LOGF
+static void logf_unlocked(const char *fmt, ...)
+{
+    char buf[128];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof (buf), fmt, ap);
+    va_end(ap);
+
+    void *self = codec_lock();
+    ci_locked.logf("%s", buf);
+    codec_unlock(self);
+}
+#endif
+
+/* Swap in the wrappers; the callbacks are only ever set up once */
+static void codec_api_wrap(struct codec_api *api)
+{
+    if (api->pcmbuf_insert == pcmbuf_insert_unlocked)
+        return;
+
+    ci_locked = *api;
+
+    api->codec_get_buffer = codec_get_buffer_unlocked;
+    api->pcmbuf_insert    = pcmbuf_insert_unlocked;
+    api->set_elapsed      = set_elapsed_unlocked;
+    api->read_filebuf     = read_filebuf_unlocked;
+    api->request_buffer   = request_buffer_unlocked;
+    api->advance_buffer   = advance_buffer_unlocked;
+    api->seek_buffer      = seek_buffer_unlocked;
+    api->seek_complete    = seek_complete_unlocked;
+    api->set_offset       = set_offset_unlocked;
+    api->configure        = configure_unlocked;
+    api->get_command      = get_command_unlocked;
+    api->loop_track       = loop_track_unlocked;
+    api->sleep            = sleep_unlocked;
+    api->yield            = yield_unlocked;
+#ifdef ROCKBOX_HAS_LOGF
+    api->logf             = logf_unlocked;
+#endif
+}
+
+/* Encoders keep running under the lock; their callbacks aren't wrapped */
+static bool codec_runs_unlocked(void)
+{
+    return sim_parallel_codec && c_hdr->lc_hdr.magic == CODEC_MAGIC;
+}
+
+static int codec_call_entry(enum codec_entry_call_reason reason)
+{
+    if (!codec_runs_unlocked())
+        return c_hdr->entry_point(reason);
+
+    codec_unlocked_self = sim_thread_unlock();
+    int status = c_hdr->entry_point(reason);
+    codec_lock();
+    return status;
+}
+
+static int codec_call_run(void)
+{
+    if (!codec_runs_unlocked())
+        return c_hdr->run_proc();
+
+    codec_unlocked_self = sim_thread_unlock();
+    int status = c_hdr->run_proc();
+    codec_lock();
+    return status;
+}
+#else
+#define codec_call_entry(reason) (c_hdr->entry_point(reason))
+#define codec_call_run()         (c_hdr->run_proc())
+#endif /* HAVE_SDL_THREADS */
+
 static int codec_load_ram(struct codec_api *api)
 {
     struct lc_header *hdr;
@@ -220,8 +431,13 @@ static int codec_load_ram(struct codec_api *api)
 
     *(c_hdr->api) = api;
 
+#ifdef HAVE_SDL_THREADS
+    if (codec_runs_unlocked())
+        codec_api_wrap(api);
+#endif
+
     logf("Codec: calling entrypoint");
-    return c_hdr->entry_point(CODEC_LOAD);
+    return codec_call_entry(CODEC_LOAD);
 }
 
 int codec_load_buf(int hid, struct codec_api *api)
@@ -243,12 +459,192 @@ int codec_load_buf(int hid, struct codec_api *api)
     return codec_load_ram(api);
 }
 
+#ifdef HAVE_CODEC_CACHE
+/* Images of recently used codecs, kept back to back at the start of an area
+ * of the audio buffer that playback hands over. Loading a codec from here is
+ * a memcpy instead of a disk access; when the area or the table fills up,
+ * the least recently used images are dropped. */
+#define CODEC_CACHE_ENTRIES     8
+#define CODEC_CACHE_SLOT(size)  ALIGN_UP((size), sizeof (intptr_t))
+
+static struct codec_cache_entry
+{
+    char          name[16]; /* codec root name */
+    size_t        offset;   /* offset of the image in the cache area */
+    size_t        size;     /* size of the image file */
+    unsigned long lastuse;  /* codec_cache_clock at the last load */
+} codec_cache_entries[CODEC_CACHE_ENTRIES];
+
+static unsigned char *codec_cache_buf;
+static unsigned long codec_cache_clock;
+static struct codec_cache_info codec_cache_stats;
+
+/* Hand the cache a new area, or take it away with buf == NULL. Whatever was
+ * in the old area is gone. */
+void codec_cache_init(void *buf, size_t size)
+{
+    if (buf != NULL)
+        ALIGN_BUFFER(buf, size, sizeof (intptr_t));
+    else
+        size = 0;
+
+    codec_cache_buf = size ? buf : NULL;
+    codec_cache_stats.size  = size;
+    codec_cache_stats.used  = 0;
+    codec_cache_stats.count = 0;
+}
+
+void codec_cache_get_info(struct codec_cache_info *info)
+{
+    *info = codec_cache_stats;
+}
+
+/* Returns the name and image size of the i-th cached codec, by position */
+const char * codec_cache_get_entry(unsigned int i, size_t *size)
+{
+    if (i >= codec_cache_stats.count)
+        return NULL;
+
+    *size = codec_cache_entries[i].size;
+    return codec_cache_entries[i].name;
+}
+
+static int codec_cache_find(const char *name)
+{
+    for (unsigned int i = 0; i < codec_cache_stats.count; i++) {
+        if (!strcmp(codec_cache_entries[i].name, name))
+            return i;
+    }
+
+    return -1;
+}
+
+/* Drop entry i, sliding the images behind it down to close the gap */
+static void codec_cache_remove(unsigned int i)
+{
+    struct codec_cache_entry *e = &codec_cache_entries[i];
+    size_t slot = CODEC_CACHE_SLOT(e->size);
+    size_t tail = codec_cache_stats.used - e->offset - slot;
+
+    memmove(codec_cache_buf + e->offset,
+            codec_cache_buf + e->offset + slot, tail);
+
+    codec_cache_stats.used -= slot;
+    codec_cache_stats.count--;
+
+    for (; i < codec_cache_stats.count; i++) {
+        codec_cache_entries[i] = codec_cache_entries[i+1];
+        codec_cache_entries[i].offset -= slot;
+    }
+}
+
+/* Evict least recently used images until one of the given size fits at the
+ * end of the cache */
+static bool codec_cache_make_room(size_t size)
+{
+    size_t slot = CODEC_CACHE_SLOT(size);
+
+    if (slot > codec_cache_stats.size)
+        return false;
+
+    while (codec_cache_stats.count >= CODEC_CACHE_ENTRIES ||
+           codec_cache_stats.size - codec_cache_stats.used < slot) {
+        unsigned int lru = 0;
+
+        for (unsigned int i = 1; i < codec_cache_stats.count; i++) {
+            if (codec_cache_entries[i].lastuse <
+                    codec_cache_entries[lru].lastuse)
+                lru = i;
+        }
+
+        logf("Codec: cache drops %s", codec_cache_entries[lru].name);
+        codec_cache_remove(lru);
+        codec_cache_stats.evictions++;
+    }
+
+    return true;
+}
+
+/* Read a codec image from disk into a new entry. Returns the entry index or
+ * -1 if it can't be kept. */
+static int codec_cache_add(const char *name, const char *path)
+{
+    if (codec_cache_buf == NULL ||
+        strlen(name) >= sizeof (codec_cache_entries[0].name))
+        return -1;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    off_t size = filesize(fd);
+    int i = -1;
+
+    if (size > 0 && size <= CODEC_SIZE && codec_cache_make_room(size)) {
+        size_t offset = codec_cache_stats.used;
+
+        if (read(fd, codec_cache_buf + offset, size) == size) {
+            struct codec_cache_entry *e = &codec_cache_entries[
+                                                codec_cache_stats.count];
+            strcpy(e->name, name);
+            e->offset = offset;
+            e->size   = size;
+
+            codec_cache_stats.used += CODEC_CACHE_SLOT(size);
+            i = codec_cache_stats.count++;
+        }
+    }
+
+    close(fd);
+    return i;
+}
+
+/* Put the image of the named codec into codecbuf, going through the cache.
+ * Returns the image size or -1 if the caller must load it itself. */
+static ssize_t codec_cache_load(const char *name, const char *path,
+                                bool *hit)
+{
+    int i = codec_cache_find(name);
+
+    *hit = i >= 0;
+
+    if (i < 0) {
+        i = codec_cache_add(name, path);
+        if (i < 0)
+            return -1;
+    }
+
+    struct codec_cache_entry *e = &codec_cache_entries[i];
+    e->lastuse = ++codec_cache_clock;
+
+#if NUM_CORES > 1
+    /* Make sure COP cache is flushed and invalidated before loading */
+    {
+        int my_core = switch_core(CURRENT_CORE ^ 1);
+        switch_core(my_core);
+    }
+#endif
+
+    memcpy(codecbuf, codec_cache_buf + e->offset, e->size);
+    return e->size;
+}
+#endif /* HAVE_CODEC_CACHE */
+
 int codec_load_file(const char *plugin, struct codec_api *api)
 {
     char path[MAX_PATH];
 
     codec_get_full_path(path, plugin);
 
+#ifdef HAVE_CODEC_CACHE
+    long start = current_tick;
+    bool hit = false;
+    ssize_t size = codec_cache_load(plugin, path, &hit);
+
+    if (size >= 0)
+        curr_handle = lc_open_from_mem(codecbuf, size);
+    else
+#endif
     curr_handle = lc_open(path, codecbuf, CODEC_SIZE);
 
     if (curr_handle == NULL) {
@@ -256,7 +652,28 @@ int codec_load_file(const char *plugin, struct codec_api *api)
         return CODEC_ERROR;
     }
 
+#ifdef HAVE_CODEC_CACHE
+    if (hit) {
+        codec_cache_stats.hits++;
+        codec_cache_stats.hit_ticks += current_tick - start;
+    } else {
+        codec_cache_stats.misses++;
+        codec_cache_stats.miss_ticks += current_tick - start;
+    }
+
+    int status = codec_load_ram(api);
+
+    /* don't keep an image that doesn't pass as a codec */
+    if (curr_handle == NULL && size >= 0) {
+        int i = codec_cache_find(plugin);
+        if (i >= 0)
+            codec_cache_remove(i);
+    }
+
+    return status;
+#else
     return codec_load_ram(api);
+#endif
 }
 
 int codec_run_proc(void)
@@ -267,7 +684,7 @@ int codec_run_proc(void)
     }
 
     logf("Codec: entering run state");
-    return c_hdr->run_proc();
+    return codec_call_run();
 }
 
 int codec_close(void)
@@ -276,7 +693,7 @@ int codec_close(void)
 
     if (curr_handle != NULL) {
         logf("Codec: cleaning up");
-        status = c_hdr->entry_point(CODEC_UNLOAD);
+        status = codec_call_entry(CODEC_UNLOAD);
         lc_close(curr_handle);
         curr_handle = NULL;
     }
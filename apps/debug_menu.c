@@ -61,6 +61,7 @@
 #include "rtc.h"
 #include "storage.h"
 #include "fs_defines.h"
+#include "fat.h"
 #include "eeprom_24cxx.h"
 #if (CONFIG_STORAGE & STORAGE_MMC) || (CONFIG_STORAGE & STORAGE_SD)
 #include "sdmmc.h"
@@ -86,6 +87,9 @@
 #include "pcmbuf.h"
 #include "buffering.h"
 #include "playback.h"
+#ifdef HAVE_CODEC_CACHE
+#include "codecs.h"
+#endif
 #if defined(HAVE_SPDIF_OUT) || defined(HAVE_SPDIF_IN)
 #include "spdif.h"
 #endif
@@ -244,6 +248,90 @@ static bool dbg_os(void)
     return simplelist_show_list(&info);
 }
 
+#ifdef HAVE_THREAD_STATS
+/* Prints the scheduler statistics of every thread, either to the list
+   (fd < 0) or to a file */
+static void thread_stats_print(int fd)
+{
+    struct thread_debug_info info;
+    uint64_t total = 0;
+    char buf[3][64];
+
+    for (int i = 0; i < MAXTHREADS; i++)
+    {
+        if (thread_get_debug_info(i, &info) > 0)
+            total += info.stats.run_time;
+    }
+
+    if (total == 0)
+        total = 1;
+
+    for (int i = 0; i < MAXTHREADS; i++)
+    {
+        if (thread_get_debug_info(i, &info) <= 0)
+            continue;
+
+        struct thread_stats *s = &info.stats;
+        unsigned long share = s->run_time * 1000 / total;
+        unsigned long ready_avg = s->switches ?
+            (unsigned long)(s->ready_time / s->switches) : 0;
+
+        snprintf(buf[0], sizeof (buf[0]), "%2d: %s: cpu %lu.%lu%%, %lu sw",
+                 i, info.name, share / 10, share % 10, s->switches);
+        snprintf(buf[1], sizeof (buf[1]), "    run %lu ms, ready %lu/%lu us",
+                 (unsigned long)(s->run_time / 1000), ready_avg,
+                 s->max_ready);
+        snprintf(buf[2], sizeof (buf[2]), "    blk %lu ms, %lu x, max %lu ms %p",
+                 (unsigned long)(s->blocked_time / 1000), s->blocks,
+                 s->max_blocked / 1000, s->max_blocked_on);
+
+        for (int l = 0; l < 3; l++)
+        {
+            if (fd >= 0)
+                fdprintf(fd, "%s\n", buf[l]);
+            else
+                simplelist_addline("%s", buf[l]);
+        }
+    }
+}
+
+static int thread_stats_callback(int btn, struct gui_synclist *lists)
+{
+    (void)lists;
+
+    if (btn == ACTION_STD_OK)
+    {
+        int fd = open(ROCKBOX_DIR "/thread_stats.txt",
+                      O_CREAT|O_WRONLY|O_TRUNC, 0666);
+        if (fd >= 0)
+        {
+            thread_stats_print(fd);
+            close(fd);
+            splash(HZ, "Thread stats dumped");
+        }
+        else
+            splash(HZ, "Failed to create thread_stats.txt");
+    }
+
+    simplelist_reset_lines();
+    thread_stats_print(-1);
+
+    if (btn == ACTION_NONE || btn == ACTION_STD_OK)
+        btn = ACTION_REDRAW;
+
+    return btn;
+}
+
+static bool dbg_thread_stats(void)
+{
+    struct simplelist_info info;
+    simplelist_info_init(&info, "Thread stats (select: dump)", 0, NULL);
+    info.action_callback = thread_stats_callback;
+    info.timeout = HZ;
+    return simplelist_show_list(&info);
+}
+#endif /* HAVE_THREAD_STATS */
+
 #ifdef __linux__
 #include "cpuinfo-linux.h"
 
@@ -471,6 +559,19 @@ static bool dbg_buffering_thread(void)
 
             screens[i].putsf(0, line++, "handle count: %d", (int)d.num_handles);
 
+            if (d.lookups > 0)
+            {
+                /* average hash chain length per handle lookup, in 0.01 */
+                unsigned long avgsteps =
+                    (unsigned long long)d.lookup_steps * 100 / d.lookups;
+                screens[i].putsf(0, line++, "lookup: %lu.%02lu max: %d",
+                                 avgsteps / 100, avgsteps % 100,
+                                 d.lookup_max_steps);
+            }
+
+            screens[i].putsf(0, line++, "read chunk: %luKB",
+                             (unsigned long)d.filechunk / 1024);
+
 #if (CONFIG_PLATFORM & PLATFORM_NATIVE)
             screens[i].putsf(0, line++, "cpu freq: %3dMHz",
                              (int)((FREQ + 500000) / 1000000));
@@ -550,6 +651,74 @@ static bool dbg_buflib_allocs(void)
 }
 #endif /* BUFLIB_DEBUG_PRINT */
 
+static int buflib_stats_callback(int btn, struct gui_synclist *lists)
+{
+    (void)lists;
+    struct buflib_stats stats;
+    core_get_stats(&stats);
+
+    simplelist_reset_lines();
+    simplelist_addline("Allocs: %lu", stats.allocs);
+    simplelist_addline("Frees: %lu", stats.frees);
+    simplelist_addline("Index hits: %lu", stats.index_hits);
+    simplelist_addline("Walks: %lu", stats.walks);
+    unsigned long avg = stats.walks ? stats.walk_blocks / stats.walks : 0;
+    simplelist_addline("Walk length: %lu avg, %lu max", avg, stats.walk_max);
+    simplelist_addline("Compactions: %lu", stats.compactions);
+    simplelist_addline("Bytes moved: %lu", stats.bytes_moved);
+    simplelist_addline("Available: %zu B", core_available());
+
+    if (btn == ACTION_NONE)
+        btn = ACTION_REDRAW;
+
+    return btn;
+}
+
+static bool dbg_buflib_stats(void)
+{
+    struct simplelist_info info;
+    simplelist_info_init(&info, "buflib stats", 0, NULL);
+    info.action_callback = buflib_stats_callback;
+    info.timeout = HZ;
+    return simplelist_show_list(&info);
+}
+
+#ifdef HAVE_CODEC_CACHE
+static int codec_cache_callback(int btn, struct gui_synclist *lists)
+{
+    (void)lists;
+    struct codec_cache_info info;
+    codec_cache_get_info(&info);
+
+    simplelist_reset_lines();
+    simplelist_addline("Used: %zu/%zu B", info.used, info.size);
+    simplelist_addline("Hits: %lu, %ld ms", info.hits,
+                       info.hit_ticks * (1000 / HZ));
+    simplelist_addline("Disk loads: %lu, %ld ms", info.misses,
+                       info.miss_ticks * (1000 / HZ));
+    simplelist_addline("Evictions: %lu", info.evictions);
+
+    const char *name;
+    size_t size;
+    for (unsigned int i = 0; (name = codec_cache_get_entry(i, &size)); i++)
+        simplelist_addline("%s: %zu B", name, size);
+
+    if (btn == ACTION_NONE)
+        btn = ACTION_REDRAW;
+
+    return btn;
+}
+
+static bool dbg_codec_cache(void)
+{
+    struct simplelist_info info;
+    simplelist_info_init(&info, "codec cache", 0, NULL);
+    info.action_callback = codec_cache_callback;
+    info.timeout = HZ;
+    return simplelist_show_list(&info);
+}
+#endif /* HAVE_CODEC_CACHE */
+
 #if (CONFIG_PLATFORM & PLATFORM_NATIVE)
 static const char* dbg_partitions_getname(int selected_item, void *data,
                                           char *buffer, size_t buffer_len)
@@ -1850,6 +2019,38 @@ static bool dbg_disk_info(void)
     info.scroll_all = true;
     return simplelist_show_list(&info);
 }
+
+#if FAT_EXTENT_CACHE_SIZE > 0
+static int fat_extent_callback(int btn, struct gui_synclist *lists)
+{
+    (void)lists;
+    struct fat_extent_stats stats;
+    fat_get_extent_stats(&stats);
+
+    simplelist_reset_lines();
+    simplelist_addline("Runs per file: %d", FAT_EXTENT_CACHE_SIZE);
+    simplelist_addline("Hits: %lu", stats.hits);
+    simplelist_addline("Misses: %lu", stats.misses);
+    unsigned int hitrate = stats.hits + stats.misses ?
+        1000ull*stats.hits / (stats.hits + stats.misses) : 0;
+    simplelist_addline("Hit rate: %u.%u%%", hitrate / 10, hitrate % 10);
+    simplelist_addline("FAT reads: %lu", stats.fatreads);
+
+    if (btn == ACTION_NONE)
+        btn = ACTION_REDRAW;
+
+    return btn;
+}
+
+static bool dbg_fat_extent_info(void)
+{
+    struct simplelist_info info;
+    simplelist_info_init(&info, "FAT Extent Cache", 0, NULL);
+    info.action_callback = fat_extent_callback;
+    info.timeout = HZ;
+    return simplelist_show_list(&info);
+}
+#endif /* FAT_EXTENT_CACHE_SIZE */
 #endif /* PLATFORM_NATIVE */
 
 #ifdef HAVE_DIRCACHE
@@ -2752,6 +2953,9 @@ static const struct {
         { "Catch mem accesses", dbg_set_memory_guard },
 #endif
         { "View OS stacks", dbg_os },
+#ifdef HAVE_THREAD_STATS
+        { "View thread stats", dbg_thread_stats },
+#endif
 #ifdef __linux__
         { "View CPU stats", dbg_cpuinfo },
 #endif
@@ -2776,6 +2980,9 @@ static const struct {
         { "View/Dump S.M.A.R.T. data", dbg_ata_smart},
 #endif
 #endif
+#if FAT_EXTENT_CACHE_SIZE > 0
+        { "View FAT extent cache", dbg_fat_extent_info },
+#endif
 #endif
         { "Metadata log", dbg_metadatalog },
 #ifdef HAVE_DIRCACHE
@@ -2790,6 +2997,10 @@ static const struct {
 #endif /* PM_DEBUG */
 #ifdef BUFLIB_DEBUG_PRINT
         { "View buflib allocs", dbg_buflib_allocs },
+#endif
+        { "View buflib stats", dbg_buflib_stats },
+#ifdef HAVE_CODEC_CACHE
+        { "View codec cache", dbg_codec_cache },
 #endif
 #ifndef SIMULATOR
 #if CONFIG_TUNER
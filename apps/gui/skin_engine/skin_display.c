@@ -439,11 +439,18 @@ int evaluate_conditional(struct gui_wps *gwps, int offset,
 
     char result[128];
     const char *value;
+    struct wps_data *data = gwps->data;
+    struct wps_token *token = SKINOFFSETTOPTR(get_skin_buffer(data),
+                                              conditional->token);
+    bool cacheable = token && token->track_only && offset == 0 &&
+                     data->token_cache_gen != 0;
+
+    if (cacheable && conditional->cache_gen == data->token_cache_gen)
+        return conditional->cache_value;
 
     int intval = num_options < 2 ? 2 : num_options;
     /* get_token_value needs to know the number of options in the enum */
-    value = get_token_value(gwps, SKINOFFSETTOPTR(get_skin_buffer(gwps->data), conditional->token),
-                    offset, result, sizeof(result), &intval);
+    value = get_token_value(gwps, token, offset, result, sizeof(result), &intval);
 
     /* intval is now the number of the enum option we want to read,
        starting from 1. If intval is -1, we check if value is empty. */
@@ -457,6 +464,11 @@ int evaluate_conditional(struct gui_wps *gwps, int offset,
     else if (intval > num_options || intval < 1)
         intval = num_options;
 
+    if (cacheable)
+    {
+        conditional->cache_value = intval - 1;
+        conditional->cache_gen = data->token_cache_gen;
+    }
     return intval -1;
 }
 
@@ -358,6 +358,7 @@ bool dbg_skin_engine(void)
         simplelist_addline("%s display:",
                            j == 0 ? "Main" : "Remote");
 #endif
+        simplelist_addline("Pushed: %lu pixels/s", skin_get_pixel_rate(j));
         for (i = 0; i < skin_get_num_skins(); i++) {
             struct skin_stats *stats = skin_get_stats(i, j);
             if (stats->buflib_handles)
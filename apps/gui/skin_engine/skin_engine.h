@@ -84,6 +84,8 @@ bool skin_do_full_update(enum skinnable_screens skin, enum screen_type screen);
 void skin_request_full_update(enum skinnable_screens skin);
 
 bool dbg_skin_engine(void);
+/* Pixels per second pushed to the display by skin rendering */
+unsigned long skin_get_pixel_rate(enum screen_type screen);
 
 #endif /* !PLUGIN */
 #endif
@@ -1903,6 +1903,41 @@ static bool check_feature_tag(const int type)
     }
 }
 
+/* Tags whose value only depends on the current or next track. Any change
+ * to those comes with a full skin refresh (track change, next track id3,
+ * cuesheet subtrack) so their value can be kept between refreshes. */
+static bool is_track_only_tag(const int type)
+{
+    switch (type)
+    {
+        case SKIN_TOKEN_FILE_BITRATE:
+        case SKIN_TOKEN_FILE_CODEC:
+        case SKIN_TOKEN_FILE_FREQUENCY:
+        case SKIN_TOKEN_FILE_FREQUENCY_KHZ:
+        case SKIN_TOKEN_FILE_NAME:
+        case SKIN_TOKEN_FILE_NAME_WITH_EXTENSION:
+        case SKIN_TOKEN_FILE_PATH:
+        case SKIN_TOKEN_FILE_SIZE:
+        case SKIN_TOKEN_FILE_VBR:
+        case SKIN_TOKEN_FILE_DIRECTORY:
+        case SKIN_TOKEN_METADATA_ARTIST:
+        case SKIN_TOKEN_METADATA_COMPOSER:
+        case SKIN_TOKEN_METADATA_ALBUM_ARTIST:
+        case SKIN_TOKEN_METADATA_GROUPING:
+        case SKIN_TOKEN_METADATA_ALBUM:
+        case SKIN_TOKEN_METADATA_GENRE:
+        case SKIN_TOKEN_METADATA_DISC_NUMBER:
+        case SKIN_TOKEN_METADATA_TRACK_NUMBER:
+        case SKIN_TOKEN_METADATA_TRACK_TITLE:
+        case SKIN_TOKEN_METADATA_VERSION:
+        case SKIN_TOKEN_METADATA_YEAR:
+        case SKIN_TOKEN_METADATA_COMMENT:
+            return true;
+        default:
+            return false;
+    }
+}
+
 /* This is used to free any buflib allocations before the rest of
  * wps_data is reset.
  * The call to this in settings_apply_skins() is the last chance to do
@@ -2376,6 +2411,18 @@ static int skin_element_callback(struct skin_element* element, void* data)
             memset(token, 0, sizeof(*token));
             token->type = element->tag->type;
             token->value.data = INVALID_OFFSET;
+            token->cache = INVALID_OFFSET;
+            token->track_only = is_track_only_tag(token->type);
+            /* conditionals keep their result in struct conditional instead */
+            if (token->track_only && !element->is_conditional)
+            {
+                struct skin_token_cache *cache =
+                        skin_buffer_alloc(sizeof(*cache));
+                if (!cache)
+                    return CALLBACK_ERROR;
+                cache->gen = 0;
+                token->cache = PTRTOSKINOFFSET(skin_buffer, cache);
+            }
 
             if (element->tag->flags&SKIN_RTC_REFRESH)
             {
@@ -2558,6 +2605,7 @@ static int skin_element_callback(struct skin_element* element, void* data)
         {
             struct conditional *conditional = skin_buffer_alloc(sizeof(*conditional));
             conditional->last_value = -1;
+            conditional->cache_gen = 0;
             conditional->token = element->data;
             element->data = PTRTOSKINOFFSET(skin_buffer, conditional);
             if (!check_feature_tag(element->tag->type))
@@ -85,6 +85,174 @@ static void skin_render_playlistviewer(struct playlistviewer* viewer,
 
 static char* skin_buffer;
 
+/* Areas drawn during a skin_render() pass, in screen coordinates; only
+ * these are pushed to the display at the end of the pass */
+#define SKIN_DIRTY_RECTS    8
+#define SKIN_DIRTY_FULL     (-1)
+
+struct dirty_rect
+{
+    int x1, y1, x2, y2; /* x2/y2 exclusive */
+};
+
+static struct skin_dirty
+{
+    int count; /* rectangles in use or SKIN_DIRTY_FULL */
+    struct dirty_rect rect[SKIN_DIRTY_RECTS];
+} skin_dirty;
+
+/* Pixels pushed to each display, for the debug screen */
+static struct skin_update_stats
+{
+    unsigned long pixels; /* pushed since start */
+    long start;           /* tick the measurement started */
+    unsigned long rate;   /* pixels per second over the last measurement */
+} update_stats[NB_SCREENS];
+
+static inline int dirty_area(const struct dirty_rect *r)
+{
+    return (r->x2 - r->x1) * (r->y2 - r->y1);
+}
+
+static inline void dirty_union(struct dirty_rect *d,
+                               const struct dirty_rect *r)
+{
+    d->x1 = MIN(d->x1, r->x1);
+    d->y1 = MIN(d->y1, r->y1);
+    d->x2 = MAX(d->x2, r->x2);
+    d->y2 = MAX(d->y2, r->y2);
+}
+
+static void skin_dirty_mark(struct screen *display,
+                            int x, int y, int width, int height)
+{
+    if (skin_dirty.count == SKIN_DIRTY_FULL)
+        return;
+
+    struct dirty_rect r = {
+        .x1 = MAX(x, 0), .y1 = MAX(y, 0),
+        .x2 = MIN(x + width, display->lcdwidth),
+        .y2 = MIN(y + height, display->lcdheight),
+    };
+
+    if (r.x1 >= r.x2 || r.y1 >= r.y2)
+        return;
+
+    /* Merge with any rectangle whose union with this one wastes less than
+     * about a scanline over the two separately - that covers overlapping
+     * and adjacent ones, such as consecutive lines. The result can then
+     * touch others, so start over after each merge. */
+    int i = 0;
+    while (i < skin_dirty.count)
+    {
+        struct dirty_rect u = r;
+        dirty_union(&u, &skin_dirty.rect[i]);
+
+        if (dirty_area(&u) <= dirty_area(&r) + dirty_area(&skin_dirty.rect[i])
+                                + display->lcdwidth)
+        {
+            r = u;
+            skin_dirty.rect[i] = skin_dirty.rect[--skin_dirty.count];
+            i = 0;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    if (skin_dirty.count < SKIN_DIRTY_RECTS)
+    {
+        skin_dirty.rect[skin_dirty.count++] = r;
+        return;
+    }
+
+    /* Out of slots; grow the one that grows the least */
+    int best = 0, best_cost = 0;
+    for (i = 0; i < SKIN_DIRTY_RECTS; i++)
+    {
+        struct dirty_rect u = r;
+        dirty_union(&u, &skin_dirty.rect[i]);
+        int cost = dirty_area(&u) - dirty_area(&skin_dirty.rect[i]);
+
+        if (i == 0 || cost < best_cost)
+        {
+            best = i;
+            best_cost = cost;
+        }
+    }
+
+    dirty_union(&skin_dirty.rect[best], &r);
+}
+
+static inline void skin_dirty_mark_vp(struct screen *display,
+                                      const struct viewport *vp)
+{
+    skin_dirty_mark(display, vp->x, vp->y, vp->width, vp->height);
+}
+
+static inline void skin_dirty_mark_line(struct screen *display,
+                                        const struct viewport *vp, int line)
+{
+    int h = display->getcharheight();
+    int y = line * h;
+
+    if (y < vp->height)
+        skin_dirty_mark(display, vp->x, vp->y + y,
+                        vp->width, MIN(h, vp->height - y));
+}
+
+/* Push the dirty areas to the display; a full update when most of it
+   changed anyway */
+static void skin_dirty_flush(struct screen *display)
+{
+    int screen_area = display->lcdwidth * display->lcdheight;
+    int pixels = 0;
+
+    if (skin_dirty.count != SKIN_DIRTY_FULL)
+    {
+        for (int i = 0; i < skin_dirty.count; i++)
+            pixels += dirty_area(&skin_dirty.rect[i]);
+
+        if (pixels >= screen_area*3/4)
+            skin_dirty.count = SKIN_DIRTY_FULL;
+    }
+
+    if (skin_dirty.count == SKIN_DIRTY_FULL)
+    {
+        display->update();
+        pixels = screen_area;
+    }
+    else
+    {
+        for (int i = 0; i < skin_dirty.count; i++)
+        {
+            struct dirty_rect *r = &skin_dirty.rect[i];
+            display->update_rect(r->x1, r->y1, r->x2 - r->x1, r->y2 - r->y1);
+        }
+    }
+
+    skin_dirty.count = 0;
+
+    struct skin_update_stats *stats = &update_stats[display->screen_type];
+    long elapsed = current_tick - stats->start;
+
+    stats->pixels += pixels;
+
+    if (elapsed >= HZ)
+    {
+        stats->rate = (unsigned long long)stats->pixels * HZ / elapsed;
+        stats->pixels = 0;
+        stats->start = current_tick;
+    }
+}
+
+/* Pixels per second pushed by the skin engine to the given screen */
+unsigned long skin_get_pixel_rate(enum screen_type screen)
+{
+    return update_stats[screen].rate;
+}
+
 static inline struct skin_element*
 get_child(OFFSETTYPE(struct skin_element**) children, int child)
 {
@@ -101,6 +269,7 @@ static bool do_non_text_tags(struct gui_wps *gwps, struct skin_draw_info *info,
     struct skin_viewport *skin_vp = info->skin_vp;
     struct wps_data *data = gwps->data;
     bool do_refresh = (element->tag->flags & info->refresh_type) > 0;
+    bool drawn = false;
 
     switch (token->type)
     {
@@ -189,7 +358,10 @@ static bool do_non_text_tags(struct gui_wps *gwps, struct skin_draw_info *info,
         case SKIN_TOKEN_PEAKMETER:
             data->peak_meter_enabled = true;
             if (do_refresh)
+            {
                 draw_peakmeters(gwps, info->line_number, &skin_vp->vp);
+                drawn = true;
+            }
             break;
         case SKIN_TOKEN_DRAWRECTANGLE:
             if (do_refresh)
@@ -197,6 +369,7 @@ static bool do_non_text_tags(struct gui_wps *gwps, struct skin_draw_info *info,
                 struct draw_rectangle *rect =
                         SKINOFFSETTOPTR(skin_buffer, token->value.data);
                 if (!rect) break;
+                drawn = true;
 #ifdef HAVE_LCD_COLOR
                 if (rect->start_colour != rect->end_colour &&
                     gwps->display->screen_type == SCREEN_MAIN)
@@ -232,14 +405,20 @@ static bool do_non_text_tags(struct gui_wps *gwps, struct skin_draw_info *info,
         {
             struct progressbar *bar = (struct progressbar*)SKINOFFSETTOPTR(skin_buffer, token->value.data);
             if (do_refresh)
+            {
                 draw_progressbar(gwps, info->skin_vp, info->line_number, bar);
+                drawn = true;
+            }
         }
         break;
         case SKIN_TOKEN_IMAGE_DISPLAY:
         {
             struct gui_img *img = SKINOFFSETTOPTR(skin_buffer, token->value.data);
             if (img && img->loaded && do_refresh)
+            {
                 img->display = 0;
+                drawn = true;
+            }
         }
         break;
         case SKIN_TOKEN_IMAGE_DISPLAY_LISTICON:
@@ -252,6 +431,7 @@ static bool do_non_text_tags(struct gui_wps *gwps, struct skin_draw_info *info,
             struct gui_img *img = skin_find_item(label,SKIN_FIND_IMAGE, data);
             if (img && img->loaded)
             {
+                drawn = true;
                 if (SKINOFFSETTOPTR(skin_buffer, id->token) == NULL)
                 {
                     img->display = id->subimage;
@@ -304,6 +484,7 @@ static bool do_non_text_tags(struct gui_wps *gwps, struct skin_draw_info *info,
                     }
 #endif
                     aa->draw_handle = handle;
+                    drawn = true;
                 }
             }
             break;
@@ -316,8 +497,11 @@ static bool do_non_text_tags(struct gui_wps *gwps, struct skin_draw_info *info,
             break;
         case SKIN_TOKEN_VIEWPORT_CUSTOMLIST:
             if (do_refresh)
+            {
                 skin_render_playlistviewer(SKINOFFSETTOPTR(skin_buffer, token->value.data), gwps,
                                            info->skin_vp, info->refresh_type);
+                drawn = true;
+            }
             break;
 #ifdef HAVE_SKIN_VARIABLES
         case SKIN_TOKEN_VAR_SET:
@@ -346,6 +530,10 @@ static bool do_non_text_tags(struct gui_wps *gwps, struct skin_draw_info *info,
         default:
             return false;
     }
+
+    if (drawn)
+        skin_dirty_mark_vp(gwps->display, &skin_vp->vp);
+
     return true;
 }
 
@@ -355,6 +543,9 @@ static void do_tags_in_hidden_conditional(struct skin_element* branch,
     struct gui_wps *gwps = info->gwps;
     struct wps_data *data = gwps->data;
 
+    /* Other viewports may get cleared, don't bother tracking what */
+    skin_dirty.count = SKIN_DIRTY_FULL;
+
     /* Tags here are ones which need to be "turned off" or cleared
      * if they are in a conditional branch which isnt being used */
     if (branch->type == LINE_ALTERNATOR)
@@ -585,9 +776,9 @@ static bool skin_render_line(struct skin_element* line, struct skin_draw_info *i
                     char *bufstart = info->cur_align_start + used;
                     size_t bufsz = info->buf_size - used;
 
-                    const char *valuestr = get_token_value(info->gwps,
+                    const char *valuestr = get_cached_token_value(info->gwps,
                                                SKINOFFSETTOPTR(skin_buffer, child->data),
-                                               info->offset, bufstart, bufsz, NULL);
+                                               info->offset, bufstart, bufsz);
                     if (valuestr)
                     {
 #if CONFIG_RTC
@@ -829,6 +1020,7 @@ void skin_render_viewport(struct skin_element* viewport, struct gui_wps *gwps,
             }
             write_line(display, align, info.line_number,
                     info.line_scrolls, &info.line_desc);
+            skin_dirty_mark_line(display, &skin_viewport->vp, info.line_number);
         }
         if (!info.no_line_break)
             info.line_number++;
@@ -849,10 +1041,15 @@ void skin_render(struct gui_wps *gwps, unsigned refresh_mode)
 
     int old_refresh_mode = refresh_mode;
     skin_buffer = get_skin_buffer(gwps->data);
+    skin_dirty.count = 0;
 
     /* Framebuffer is likely dirty */
     if ((refresh_mode&SKIN_REFRESH_ALL) == SKIN_REFRESH_ALL)
     {
+        skin_dirty.count = SKIN_DIRTY_FULL;
+        /* track-only tokens may have changed, drop their cached values */
+        if (++data->token_cache_gen == 0)
+            data->token_cache_gen = 1;
         /* should already be the default buffer */
         struct viewport * first_vp = display->set_viewport_ex(NULL, 0);
         if ((first_vp->flags & VP_FLAG_VP_SET_CLEAN) == VP_FLAG_VP_DIRTY &&
@@ -916,6 +1113,7 @@ void skin_render(struct gui_wps *gwps, unsigned refresh_mode)
         if ((vp_refresh_mode&SKIN_REFRESH_ALL) == SKIN_REFRESH_ALL)
         {
             display->clear_viewport();
+            skin_dirty_mark_vp(display, &skin_viewport->vp);
         }
         /* render */
         if (viewport->children_count)
@@ -936,7 +1134,7 @@ void skin_render(struct gui_wps *gwps, unsigned refresh_mode)
     }
     /* Restore the default viewport */
     display->set_viewport_ex(NULL, VP_FLAG_VP_SET_CLEAN);
-    display->update();
+    skin_dirty_flush(display);
 }
 
 static __attribute__((noinline))
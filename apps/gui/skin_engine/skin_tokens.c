@@ -1806,3 +1806,40 @@ gtv_ret_numeric_tag_info:
     }
     return numeric_buf;
 }
+
+/* get_token_value() for the text of a line, track-only tokens are served
+   from their cache until the next full refresh. */
+const char *get_cached_token_value(struct gui_wps *gwps,
+                                   struct wps_token *token, int offset,
+                                   char *buf, int buf_size)
+{
+    struct wps_data *data = gwps->data;
+    struct skin_token_cache *cache =
+            SKINOFFSETTOPTR(get_skin_buffer(data), token->cache);
+    const char *value;
+
+    /* offset != 0 is the playlist viewer looking at other tracks */
+    if (!cache || offset != 0 || data->token_cache_gen == 0)
+        return get_token_value(gwps, token, offset, buf, buf_size, NULL);
+
+    if (cache->gen == data->token_cache_gen)
+        return cache->len < 0 ? NULL : cache->text;
+
+    value = get_token_value(gwps, token, offset, buf, buf_size, NULL);
+    if (!value)
+    {
+        cache->len = -1;
+        cache->gen = data->token_cache_gen;
+    }
+    else
+    {
+        size_t len = strlen(value);
+        if (len < sizeof(cache->text))
+        {
+            memcpy(cache->text, value, len + 1);
+            cache->len = len;
+            cache->gen = data->token_cache_gen;
+        }
+    }
+    return value;
+}
@@ -66,6 +66,16 @@ bool skin_data_load(enum screen_type screen, struct wps_data *wps_data,
 
 #define TOKEN_VALUE_ONLY 0x0DEADC0D
 
+/* Last formatted value of a track-only token. Filled on the first render
+   pass after a full refresh and reused until the next one, values that
+   don't fit are formatted every time as before. */
+#define SKIN_TOKEN_CACHE_LEN 64
+struct skin_token_cache {
+    unsigned int gen; /* wps_data.token_cache_gen the text belongs to */
+    int len;          /* -1 if the token had no value */
+    char text[SKIN_TOKEN_CACHE_LEN];
+};
+
 /* wps_data*/
 struct wps_token {
     union {
@@ -80,6 +90,10 @@ struct wps_token {
     /* Whether the tag (e.g. track name or the album) refers the
        current or the next song (false=current, true=next) */
     bool next;
+    /* The value only changes when the track (or next track) does, which
+       always comes with a full refresh of the skin */
+    bool track_only;
+    OFFSETTYPE(struct skin_token_cache *) cache;
 };
 
 struct wps_subline_timeout {
@@ -295,6 +309,9 @@ struct line_alternator {
 struct conditional {
     int last_value;
     OFFSETTYPE(struct wps_token *) token;
+    /* result cache for track-only tokens, see struct skin_token_cache */
+    unsigned int cache_gen;
+    int cache_value;
 };
 
 struct logical_if {
@@ -384,6 +401,9 @@ struct wps_data
     OFFSETTYPE(struct skin_token_list *) skinvars;
 #endif
 
+    /* bumped on every full refresh, 0 disables the token caches */
+    unsigned int token_cache_gen;
+
     bool peak_meter_enabled;
     bool wps_sb_tag;
     bool show_sb_on_wps;
@@ -422,6 +442,9 @@ const char *get_token_value(struct gui_wps *gwps,
                            struct wps_token *token, int offset,
                            char *buf, int buf_size,
                            int *intval);
+const char *get_cached_token_value(struct gui_wps *gwps,
+                                   struct wps_token *token, int offset,
+                                   char *buf, int buf_size);
 
 /* Get the id3 fields from the cuesheet */
 const char *get_cuesheetid3_token(struct wps_token *token, struct mp3entry *id3,
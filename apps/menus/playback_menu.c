@@ -161,6 +161,22 @@ static int cuesheet_callback(int action,
 }
 MENUITEM_SETTING(cuesheet, &global_settings.cuesheet, cuesheet_callback);
 
+static int metadata_prefetch_callback(int action,
+                                      const struct menu_item_ex *this_item,
+                                      struct gui_synclist *this_list)
+{
+    (void)this_item;
+    (void)this_list;
+    switch (action)
+    {
+        case ACTION_EXIT_MENUITEM: /* on exit */
+            audio_set_metadata_prefetch(global_settings.metadata_prefetch);
+    }
+    return action;
+}
+MENUITEM_SETTING(metadata_prefetch, &global_settings.metadata_prefetch,
+                 metadata_prefetch_callback);
+
 #ifdef HAVE_HEADPHONE_DETECTION
 MENUITEM_SETTING(unplug_mode, &global_settings.unplug_mode, NULL);
 MENUITEM_SETTING(unplug_autoresume, &global_settings.unplug_autoresume, NULL);
@@ -219,7 +235,7 @@ MAKE_MENU(playback_settings,ID2P(LANG_PLAYBACK),0,
 #ifdef HAVE_SPDIF_POWER
           &spdif_enable,
 #endif
-          &next_folder, &constrain_next_folder, &cuesheet
+          &next_folder, &constrain_next_folder, &cuesheet, &metadata_prefetch
 #ifdef HAVE_HEADPHONE_DETECTION
          ,&unplug_menu
 #endif
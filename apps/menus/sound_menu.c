@@ -179,6 +179,10 @@ static int timestretch_callback(int action,
 
     MENUITEM_SETTING(dithering_enabled,
                      &global_settings.dithering_enabled, lowlatency_callback);
+#ifdef HAVE_RESAMPLE_SINC
+    MENUITEM_SETTING(resample_sinc,
+                     &global_settings.resample_sinc, lowlatency_callback);
+#endif
     MENUITEM_SETTING(afr_enabled,
                      &global_settings.afr_enabled, lowlatency_callback);
     MENUITEM_SETTING(pbe,
@@ -264,6 +268,9 @@ MAKE_MENU(sound_settings, ID2P(LANG_SOUND_SETTINGS), NULL, Icon_Audio,
           ,&power_mode
 #endif
           ,&crossfeed_menu, &equalizer_menu, &dithering_enabled
+#ifdef HAVE_RESAMPLE_SINC
+          ,&resample_sinc
+#endif
           ,&surround_menu, &pbe_menu, &afr_enabled
 #ifdef HAVE_PITCHCONTROL
           ,&timestretch_enabled
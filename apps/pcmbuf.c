@@ -41,8 +41,17 @@
 #include "audio.h"
 #include "voice_thread.h"
 
+#ifdef HAVE_PCM_HIRES
+/* 2 channels * 4 bytes/sample, interleaved, PCM_HIRES_DEPTH bits used */
+#define PCMBUF_SAMPLE_SIZE   PCM_HIRES_SAMPLE_SIZE
+typedef int32_t pcmbuf_sample_t;
+#define clip_pcmbuf_sample(s) clip_sample_depth((s), PCM_HIRES_DEPTH)
+#else
 /* 2 channels * 2 bytes/sample, interleaved */
 #define PCMBUF_SAMPLE_SIZE   (2 * 2)
+typedef int16_t pcmbuf_sample_t;
+#define clip_pcmbuf_sample(s) clip_sample_16(s)
+#endif
 
 /* This is the target fill size of chunks on the pcm buffer
    Can be any number of samples but power of two sizes make for faster and
@@ -836,8 +845,13 @@ void pcmbuf_play_start(void)
         chunk_widx != chunk_ridx)
     {
         current_desc = NULL;
+#ifdef HAVE_PCM_HIRES
+        mixer_channel_play_data_hires(PCM_MIXER_CHAN_PLAYBACK,
+                                      pcmbuf_pcm_callback, NULL, 0);
+#else
         mixer_channel_play_data(PCM_MIXER_CHAN_PLAYBACK, pcmbuf_pcm_callback,
                                 NULL, 0);
+#endif
     }
 }
 
@@ -927,7 +941,12 @@ static inline void mixfader_step(struct mixfader *faderp)
 
 static FORCE_INLINE int32_t mixfade_sample(const struct mixfader *faderp, int32_t s)
 {
+#ifdef HAVE_PCM_HIRES
+    /* Product exceeds 32 bits at high-resolution depths */
+    return ((int64_t)faderp->factor * s + MIXFADE_UNITY/2) >> MIXFADE_UNITY_BITS;
+#else
     return (faderp->factor * s + MIXFADE_UNITY/2) >> MIXFADE_UNITY_BITS;
+#endif
 }
 
 /* Cancel crossfade operation */
@@ -1009,7 +1028,7 @@ static void crossfade_mix_fade(struct mixfader *faderp, size_t size,
     if (index == INVALID_BUF_INDEX)
         return;
 
-    int16_t *inbuf = input_buf;
+    pcmbuf_sample_t *inbuf = input_buf;
 
     bool alloced = inbuf && faderp->alloc &&
                    index_chunk_offs(index, 0) == chunk_widx;
@@ -1017,7 +1036,7 @@ static void crossfade_mix_fade(struct mixfader *faderp, size_t size,
     while (size)
     {
         struct chunkdesc *desc = index_chunkdesc(index);
-        int16_t *outbuf = index_buffer(index);
+        pcmbuf_sample_t *outbuf = index_buffer(index);
 
         switch (offset)
         {
@@ -1035,7 +1054,7 @@ static void crossfade_mix_fade(struct mixfader *faderp, size_t size,
 
         size_t amount = (alloced ? PCMBUF_CHUNK_SIZE : desc->size)
                             - (index % PCMBUF_CHUNK_SIZE);
-        int16_t *chunkend = SKIPBYTES(outbuf, amount);
+        pcmbuf_sample_t *chunkend = SKIPBYTES(outbuf, amount);
 
         if (size < amount)
             amount = size;
@@ -1063,8 +1082,8 @@ static void crossfade_mix_fade(struct mixfader *faderp, size_t size,
                 int32_t right = outbuf[1];
                 left  += mixfade_sample(faderp, *inbuf++);
                 right += mixfade_sample(faderp, *inbuf++);
-                *outbuf++ = clip_sample_16(left);
-                *outbuf++ = clip_sample_16(right);
+                *outbuf++ = clip_pcmbuf_sample(left);
+                *outbuf++ = clip_pcmbuf_sample(right);
                 mixfader_step(faderp);
             }
         }
@@ -47,6 +47,7 @@
 #include "settings.h"
 #include "audiohw.h"
 #include "general.h"
+#include "string-extra.h"
 #include <stdio.h>
 
 #ifdef HAVE_TAGCACHE
@@ -143,6 +144,9 @@ static struct audio_scratch_memory
     struct mp3entry codec_id3; /* (A,C) */
     struct mp3entry unbuffered_id3;
     struct cuesheet *curr_cue; /* Will follow this structure */
+    struct mp3entry *prefetch_id3; /* (A) Will follow the cuesheet, if any */
+    unsigned int prefetch_count;   /* Number of prefetch_id3 slots */
+    unsigned int prefetch_valid;   /* (A, O) Slots holding parsed metadata */
 } * audio_scratch_memory = NULL;
 
 /* These are used to store the current, next and optionally the peek-ahead
@@ -323,6 +327,15 @@ static unsigned int track_event_flags = TEF_NONE; /* (A, O-) */
 /* Pending manual track skip offset */
 static int skip_offset = 0; /* (A, O) */
 
+/* Manual skips that follow each other closer than this are batched: the
+   first one goes through at once but the rest wait for the taps to stop so
+   that only the final track gets a full load. The WPS previews the tracks
+   in between from the playlist meanwhile (AUDIO_FAST_SKIP_PREVIEW). */
+#define SKIP_COALESCE_TIME  (HZ/4)
+static long skip_last_tick = 0;    /* (A, O) time of the last audio_skip() */
+static long skip_done_tick = 0;    /* (A) time audio_on_skip() last finished */
+static bool skip_deferred = false; /* (A) Q_AUDIO_SKIP held back */
+
 static bool track_skip_is_manual = false;
 
 /* Track change notification */
@@ -367,6 +380,7 @@ enum audio_start_playback_flags
 static void audio_start_playback(const struct audio_resume_info *resume_info,
                                  unsigned int flags);
 static void audio_stop_playback(void);
+static void audio_cancel_deferred_skip(void);
 static void buffer_event_buffer_low_callback(unsigned short id, void *data, void *user_data);
 static void buffer_event_rebuffer_callback(unsigned short id, void *data);
 static void buffer_event_finished_callback(unsigned short id, void *data);
@@ -837,6 +851,10 @@ static size_t scratch_mem_size(void)
     if (global_settings.cuesheet)
         size += sizeof (struct cuesheet);
 
+    size = ALIGN_UP(size, __alignof__ (struct mp3entry));
+    size += MIN(global_settings.metadata_prefetch, AUDIO_PREFETCH_MAX) *
+            sizeof (struct mp3entry);
+
     return size;
 }
 
@@ -850,12 +868,24 @@ static void scratch_mem_init(void *mem)
     ci.id3 = id3_get(CODEC_ID3);
     audio_scratch_memory->curr_cue = NULL;
 
+    size_t offset = sizeof (struct audio_scratch_memory);
+
     if (global_settings.cuesheet)
     {
-        audio_scratch_memory->curr_cue =
-            SKIPBYTES((struct cuesheet *)audio_scratch_memory,
-                      sizeof (struct audio_scratch_memory));
+        audio_scratch_memory->curr_cue = SKIPBYTES((struct cuesheet *)mem,
+                                                   offset);
+        offset += sizeof (struct cuesheet);
     }
+
+    offset = ALIGN_UP(offset, __alignof__ (struct mp3entry));
+
+    id3_mutex_lock();
+    audio_scratch_memory->prefetch_id3 = SKIPBYTES((struct mp3entry *)mem,
+                                                   offset);
+    audio_scratch_memory->prefetch_count =
+        MIN(global_settings.metadata_prefetch, AUDIO_PREFETCH_MAX);
+    audio_scratch_memory->prefetch_valid = 0;
+    id3_mutex_unlock();
 }
 
 static int audiobuf_handle;
@@ -901,7 +931,7 @@ static void audio_reset_buffer_noalloc(
 {
     /*
      * Layout audio buffer as follows:
-     * [|SCRATCH|BUFFERING|PCM]
+     * [|SCRATCH|CODECS|BUFFERING|PCM]
      */
     logf("%s()", __func__);
 
@@ -930,6 +960,19 @@ static void audio_reset_buffer_noalloc(
     filebuf += allocsize;
     filebuflen -= allocsize;
 
+#ifdef HAVE_CODEC_CACHE
+    /* Recently used codec images; not worth it on a small buffer */
+    {
+        size_t cachesize = CODEC_CACHE_SIZE;
+        if (cachesize > filebuflen / 4)
+            cachesize = 0;
+
+        codec_cache_init(filebuf, cachesize);
+        filebuf += cachesize;
+        filebuflen -= cachesize;
+    }
+#endif
+
 #ifdef HAVE_ALBUMART
     clear_last_folder_album_art();
 #endif
@@ -1037,6 +1080,9 @@ static int shrink_callback(int handle, unsigned hints, void* start, size_t old_s
     if (give_up)
     {
         buffer_state = AUDIOBUF_STATE_TRASHED;
+#ifdef HAVE_CODEC_CACHE
+        codec_cache_init(NULL, 0);
+#endif
         audiobuf_handle = core_free(audiobuf_handle);
         return BUFLIB_CB_OK;
     }
@@ -1190,6 +1236,161 @@ static inline void audio_pcmbuf_track_change_post(void)
 }
 
 
+/** --- Metadata prefetch --- **/
+
+/* Find parsed metadata for a path - call with the id3 mutex held when not
+   on the audio thread */
+static struct mp3entry * prefetch_find(const char *path)
+{
+    struct audio_scratch_memory *scratch = audio_scratch_memory;
+
+    if (!scratch)
+        return NULL;
+
+    for (unsigned int i = 0; i < scratch->prefetch_count; i++)
+    {
+        if ((scratch->prefetch_valid & (1u << i)) &&
+            !strcmp(scratch->prefetch_id3[i].path, path))
+            return &scratch->prefetch_id3[i];
+    }
+
+    return NULL;
+}
+
+/* Free the slot of metadata that was handed over to the buffer */
+static void prefetch_release(struct mp3entry *id3)
+{
+    struct audio_scratch_memory *scratch = audio_scratch_memory;
+
+    id3_mutex_lock();
+    scratch->prefetch_valid &= ~(1u << (id3 - scratch->prefetch_id3));
+    id3_mutex_unlock();
+}
+
+/* Length of the directory part of a path */
+static size_t prefetch_dir_len(const char *path)
+{
+    const char *sep = strrchr(path, '/');
+    return sep ? (size_t)(sep - path) : 0;
+}
+
+/* Parse the metadata of the next tracks in the playlist, starting at peek
+   offset 'offset', in one pass. Files of a directory are read one after
+   another so the disk sees a few longer bursts rather than a seek and read
+   for every track load. */
+static void prefetch_metadata(int offset)
+{
+    struct audio_scratch_memory *scratch = audio_scratch_memory;
+    unsigned int count = scratch->prefetch_count;
+    unsigned int keep = 0;  /* slots whose tracks are still coming up */
+    int want[AUDIO_PREFETCH_MAX];
+    unsigned int nwant = 0;
+    char path[MAX_PATH + 1];
+
+    for (unsigned int k = 0; k < count; k++)
+    {
+        const char *p = playlist_peek(offset + k, path, sizeof (path));
+
+        if (!p)
+            break;
+
+        struct mp3entry *id3 = prefetch_find(p);
+
+        if (id3)
+            keep |= 1u << (id3 - scratch->prefetch_id3);
+        else
+            want[nwant++] = offset + k;
+    }
+
+    if (nwant == 0)
+        return;
+
+    logf("%s(%d): %u tracks", __func__, offset, nwant);
+
+    /* Whatever isn't coming up makes room */
+    id3_mutex_lock();
+    scratch->prefetch_valid &= keep;
+    id3_mutex_unlock();
+
+    unsigned char slot[AUDIO_PREFETCH_MAX];
+    unsigned int nslot = 0;
+
+    for (unsigned int i = 0, k = 0; i < count && k < nwant; i++)
+    {
+        if (keep & (1u << i))
+            continue;
+
+        const char *p = playlist_peek(want[k++], path, sizeof (path));
+
+        if (p)
+        {
+            strmemccpy(scratch->prefetch_id3[i].path, p,
+                    sizeof (scratch->prefetch_id3[i].path));
+            slot[nslot++] = i;
+        }
+    }
+
+    /* Group by directory, keeping playlist order otherwise */
+    unsigned int done = 0;
+
+    for (unsigned int j = 0; j < nslot; j++)
+    {
+        if (done & (1u << j))
+            continue;
+
+        const char *dir = scratch->prefetch_id3[slot[j]].path;
+        size_t dirlen = prefetch_dir_len(dir);
+
+        for (unsigned int l = j; l < nslot; l++)
+        {
+            struct mp3entry *id3 = &scratch->prefetch_id3[slot[l]];
+
+            if ((done & (1u << l)) ||
+                prefetch_dir_len(id3->path) != dirlen ||
+                strncmp(id3->path, dir, dirlen))
+                continue;
+
+            done |= 1u << l;
+
+            /* get_metadata() wipes the entry first */
+            strmemccpy(path, id3->path, sizeof (path));
+
+            int fd = open(path, O_RDONLY);
+            if (fd < 0)
+                continue;
+
+            bool ok = get_metadata(id3, fd, path);
+            close(fd);
+
+            if (ok)
+            {
+                id3_mutex_lock();
+                scratch->prefetch_valid |= 1u << slot[l];
+                id3_mutex_unlock();
+            }
+        }
+    }
+}
+
+/* Get parsed metadata for the track being loaded, parsing the tracks after
+   it along with it if it isn't there yet */
+static struct mp3entry * prefetch_get(const char *path)
+{
+    if (audio_scratch_memory->prefetch_count == 0)
+        return NULL;
+
+    struct mp3entry *id3 = prefetch_find(path);
+
+    if (!id3)
+    {
+        prefetch_metadata(playlist_peek_offset);
+        id3 = prefetch_find(path);
+    }
+
+    return id3;
+}
+
+
 /** --- Helper functions --- **/
 
 /* Removes messages that might end up in the queue before or while processing
@@ -1613,8 +1814,17 @@ static bool audio_get_track_metadata(int offset, struct mp3entry *id3)
        have and return that */
 
     char path[MAX_PATH+1];
-    if (playlist_peek(offset, path, sizeof (path)))
+    const char *p = playlist_peek(offset, path, sizeof (path));
+    if (p)
     {
+        struct mp3entry *pf_id3 = prefetch_find(p);
+        if (pf_id3)
+        {
+            copy_mp3entry(id3, pf_id3);
+            id3->cuesheet = NULL;
+            return true;
+        }
+
 #if defined(HAVE_TC_RAMCACHE) && defined(HAVE_DIRCACHE)
         /* Try to get it from the database */
         if (!tagcache_fill_tags(id3, path))
@@ -2184,9 +2394,17 @@ static int audio_load_track(void)
         return LOAD_TRACK_ERR_NO_MORE;
     }
 
-    /* Successfully opened the file - get track metadata */
+    /* Successfully opened the file - get track metadata, which may have
+       been parsed already */
+    struct mp3entry *pf_id3 = NULL;
+
+    if (filling != STATE_FULL)
+        pf_id3 = prefetch_get(path);
+
     if (filling == STATE_FULL ||
-        (info.id3_hid = bufopen(path, 0, TYPE_ID3, NULL)) < 0)
+        (info.id3_hid = pf_id3 ?
+            bufalloc(pf_id3, sizeof (struct mp3entry), TYPE_ID3) :
+            bufopen(path, 0, TYPE_ID3, NULL)) < 0)
     {
         /* Buffer or track list is full */
         struct mp3entry *ub_id3;
@@ -2199,7 +2417,12 @@ static int audio_load_track(void)
         if (fd >= 0)
         {
             id3_mutex_lock();
-            get_metadata(ub_id3, fd, path);
+            if (!pf_id3)
+                pf_id3 = prefetch_find(path);
+            if (pf_id3)
+                copy_mp3entry(ub_id3, pf_id3);
+            else
+                get_metadata(ub_id3, fd, path);
             id3_mutex_unlock();
         }
 
@@ -2225,6 +2448,15 @@ static int audio_load_track(void)
 
         /* Successful load initiation */
         track_list.in_progress_hid = info.self_hid;
+
+        if (pf_id3)
+        {
+            /* Nothing for the buffering thread to parse - carry on with the
+               rest of the track right away */
+            prefetch_release(pf_id3);
+            buffer_event_finished_callback(BUFFER_EVENT_FINISHED,
+                                           &info.id3_hid);
+        }
     }
     if (fd >= 0)
         close(fd);
@@ -3027,6 +3259,9 @@ static void audio_start_playback(const struct audio_resume_info *resume_info,
         else
         {
             /* This is more-or-less treated as manual track transition */
+            /* A held back skip was meant for the old playlist */
+            audio_cancel_deferred_skip();
+
             /* Save resume information for current track */
             audio_playlist_track_finish();
             track_list_clear(TRACK_LIST_CLEAR_ALL);
@@ -3118,6 +3353,17 @@ static void audio_stop_playback(void)
 {
     logf("%s()", __func__);
 
+    audio_cancel_deferred_skip();
+
+    /* Prefetched metadata must not outlive the session that parsed it; the
+       files may be changed (over USB, say) before the next one */
+    if (audio_scratch_memory)
+    {
+        id3_mutex_lock();
+        audio_scratch_memory->prefetch_valid = 0;
+        id3_mutex_unlock();
+    }
+
     if (play_status == PLAY_STOPPED)
         return;
 
@@ -3286,6 +3532,61 @@ static void audio_on_skip(void)
     }
 
     audio_begin_track_change(TRACK_CHANGE_MANUAL, trackstat);
+
+    /* Stamped after the load, however long it took, so that taps which
+       came in meanwhile are batched */
+    skip_done_tick = current_tick;
+}
+
+/* Hold back a skip that comes right after the previous one until the
+   burst is over (Q_AUDIO_SKIP) */
+static void audio_on_skip_request(void)
+{
+    if (skip_deferred ||
+        TIME_BEFORE(current_tick, skip_done_tick + SKIP_COALESCE_TIME))
+    {
+        logf("%s(): deferred", __func__);
+        skip_deferred = true;
+        return;
+    }
+
+    audio_on_skip();
+}
+
+/* Run a held back skip once no more have come in for a while */
+static void audio_check_deferred_skip(void)
+{
+    if (skip_deferred &&
+        !TIME_BEFORE(current_tick, skip_last_tick + SKIP_COALESCE_TIME))
+    {
+        skip_deferred = false;
+        audio_on_skip();
+    }
+}
+
+/* Forget a held back skip; its delta goes with it */
+static void audio_cancel_deferred_skip(void)
+{
+    if (!skip_deferred)
+        return;
+
+    skip_deferred = false;
+
+    id3_mutex_lock();
+    skip_offset = 0;
+    id3_mutex_unlock();
+}
+
+/* Limit a queue timeout so that a held back skip runs on time */
+static int audio_skip_wait_tmo(int tmo)
+{
+    if (skip_deferred)
+    {
+        long left = skip_last_tick + SKIP_COALESCE_TIME - current_tick;
+        tmo = MAX(MIN(left, tmo), 1);
+    }
+
+    return tmo;
 }
 
 /* Skip to the next/previous directory
@@ -3294,6 +3595,8 @@ static void audio_on_dir_skip(int direction)
 {
     logf("%s(%d)", __func__, direction);
 
+    audio_cancel_deferred_skip();
+
     id3_mutex_lock();
     skip_offset = 0;
     id3_mutex_unlock();
@@ -3584,7 +3887,7 @@ void audio_playback_handler(struct queue_event *ev)
 
         case Q_AUDIO_SKIP:
             LOGFQUEUE("playback < Q_AUDIO_SKIP");
-            audio_on_skip();
+            audio_on_skip_request();
             break;
 
         case Q_AUDIO_DIR_SKIP:
@@ -3661,6 +3964,8 @@ void audio_playback_handler(struct queue_event *ev)
             break;
         } /* end switch */
 
+        audio_check_deferred_skip();
+
         switch (filling)
         {
         /* Active states */
@@ -3692,14 +3997,17 @@ void audio_playback_handler(struct queue_event *ev)
             {
                 /* If doing auto skip, poll pcmbuf track notifications a bit
                    faster to promply detect the transition */
-                queue_wait_w_tmo(&audio_queue, ev,
-                    skip_pending == TRACK_SKIP_NONE ? HZ/2 : HZ/10);
+                queue_wait_w_tmo(&audio_queue, ev, audio_skip_wait_tmo(
+                    skip_pending == TRACK_SKIP_NONE ? HZ/2 : HZ/10));
             }
             break;
 
         /* Idle states */
         default:
-            queue_wait(&audio_queue, ev);
+            if (skip_deferred)
+                queue_wait_w_tmo(&audio_queue, ev, audio_skip_wait_tmo(HZ/2));
+            else
+                queue_wait(&audio_queue, ev);
         }
     } /* end while */
 }
@@ -3962,6 +4270,9 @@ void audio_hard_stop(void)
     audio_queue_send(Q_AUDIO_STOP, 1);
 #ifdef PLAYBACK_VOICE
     voice_stop();
+#endif
+#ifdef HAVE_CODEC_CACHE
+    codec_cache_init(NULL, 0);
 #endif
     audiobuf_handle = core_free(audiobuf_handle);
 }
@@ -3999,6 +4310,7 @@ void audio_skip(int offset)
         /* Accumulate net manual skip count since the audio thread last
            processed one */
         skip_offset = accum;
+        skip_last_tick = current_tick;
 
         system_sound_play(SOUND_TRACK_SKIP);
 
@@ -4180,6 +4492,21 @@ long audio_filebufused(void)
 
 /** -- Settings -- **/
 
+/* Set the number of tracks to parse the metadata of in one pass; the slots
+   for it live in the scratch memory so the buffer must be set up again */
+void audio_set_metadata_prefetch(int count)
+{
+    unsigned int have = audio_scratch_memory ?
+                            audio_scratch_memory->prefetch_count : 0;
+
+    if (play_status == PLAY_STOPPED ||
+        (unsigned int)MIN(count, AUDIO_PREFETCH_MAX) != have)
+    {
+        LOGFQUEUE("audio >| audio Q_AUDIO_REMAKE_AUDIO_BUFFER");
+        audio_queue_send(Q_AUDIO_REMAKE_AUDIO_BUFFER, 0);
+    }
+}
+
 /* Enable or disable cuesheet support and allocate/don't allocate the
    extra associated resources */
 void audio_set_cuesheet(bool enable)
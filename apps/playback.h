@@ -33,6 +33,10 @@
 #define AUDIO_FAST_SKIP_PREVIEW
 #endif
 
+/* Most upcoming tracks to parse the metadata of in one pass; each takes an
+   mp3entry of the audio buffer (see global_settings.metadata_prefetch) */
+#define AUDIO_PREFETCH_MAX 8
+
 #ifdef HAVE_ALBUMART
 
 #include "bmp.h"
@@ -79,6 +83,7 @@ void audio_pre_ff_rewind(void);
 void audio_skip(int direction);
 
 void audio_set_cuesheet(bool enable);
+void audio_set_metadata_prefetch(int count);
 #ifdef HAVE_CROSSFADE
 void audio_set_crossfade(int enable);
 #endif
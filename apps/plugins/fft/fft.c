@@ -759,8 +759,16 @@ static inline bool fft_init_fft_lib(void)
 static inline bool fft_get_fft(void)
 {
     int count;
+#ifdef HAVE_PCM_HIRES
+    /* Playback is high-resolution; keep the 16-bit range */
+    const int32_t *value =
+        rb->mixer_channel_get_buffer(PCM_MIXER_CHAN_PLAYBACK, &count);
+#define FFT_SAMPLE(s) ((s) >> (PCM_HIRES_DEPTH - 16))
+#else
     const int16_t *value =
         rb->mixer_channel_get_buffer(PCM_MIXER_CHAN_PLAYBACK, &count);
+#define FFT_SAMPLE(s) (s)
+#endif
     /* This block can introduce discontinuities in our data. Meaning, the
      * FFT will not be done a continuous segment of the signal. Which can
      * be bad. Or not.
@@ -781,8 +789,8 @@ static inline bool fft_get_fft(void)
 
     do
     {
-        kiss_fft_scalar left = *value++;
-        kiss_fft_scalar right = *value++;
+        kiss_fft_scalar left = FFT_SAMPLE(*value++);
+        kiss_fft_scalar right = FFT_SAMPLE(*value++);
         input[fft_idx].r = (left + right) >> 1; /* to mono */
     } while (fft_idx++, --count > 0);
 
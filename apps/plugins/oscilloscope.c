@@ -1369,12 +1369,22 @@ static void waveform_buffer_done(void)
     waveform_buffer_have = have;
 }
 
+#ifdef HAVE_PCM_HIRES
+/* Playback data is high-resolution; sizes here count the 16-bit samples
+   kept in waveform_buffer */
+#define WAVEFORM_SRC_SCALE  (PCM_HIRES_SAMPLE_SIZE / (2 * sizeof (int16_t)))
+#else
+#define WAVEFORM_SRC_SCALE  1
+#endif
+
 /* where the samples are obtained and buffered */
 static void waveform_buffer_callback(const void *start, size_t size)
 {
     size_t threshold = waveform_buffer_threshold;
     size_t have = waveform_buffer_have;
 
+    size /= WAVEFORM_SRC_SCALE;
+
     if (have >= threshold)
     {
         waveform_buffer_break += size;
@@ -1406,7 +1416,7 @@ static void waveform_buffer_callback(const void *start, size_t size)
             }
 
             brk -= threshold;
-            start += size - brk;
+            start += (size - brk) * WAVEFORM_SRC_SCALE;
             size = brk;
         }
 
@@ -1422,7 +1432,15 @@ static void waveform_buffer_callback(const void *start, size_t size)
         copy = remaining;
     }
 
+#ifdef HAVE_PCM_HIRES
+    const int32_t *src = start;
+    int16_t *dst = (void *)waveform_buffer + have;
+
+    for (size_t i = 0; i < copy / sizeof (int16_t); i++)
+        dst[i] = src[i] >> (PCM_HIRES_DEPTH - 16);
+#else
     memcpy((void *)waveform_buffer + have, start, copy);
+#endif
 
     waveform_buffer_have = have + copy;
 }
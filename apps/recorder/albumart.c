@@ -30,6 +30,11 @@
 #include "pathfuncs.h"
 #include "settings.h"
 #include "wps.h"
+#ifndef PLUGIN
+#include "file.h"
+#include "dir.h"
+#include "crc32.h"
+#endif
 
 /* Define LOGF_ENABLE to enable logf output in this file */
 /*#define LOGF_ENABLE*/
@@ -277,4 +282,126 @@ bool find_albumart(const struct mp3entry *id3, char *buf, int buflen,
     return search_albumart_files(id3, size_string, buf, buflen);
 }
 
+/* Number of files in the album art cache, keys are hashed to one of them
+ * and a different key simply replaces the previous image */
+#define ALBUMART_CACHE_SLOTS 1024
+#define ALBUMART_CACHE_MAGIC 0x41414331 /* "AAC1" */
+
+struct albumart_cache_header {
+    uint32_t magic;
+    struct albumart_cache_key key;
+    int32_t width;
+    int32_t height;
+    int32_t format;
+    int32_t alpha_offset;
+    uint32_t size;
+};
+
+static void albumart_cache_path(const struct albumart_cache_key *key,
+                                char *buf, size_t bufsize)
+{
+    uint32_t hash = crc_32(key, sizeof(*key), 0xffffffff);
+    snprintf(buf, bufsize, ALBUMART_CACHE_DIR "/%03lx.aa",
+             (unsigned long)(hash % ALBUMART_CACHE_SLOTS));
+}
+
+bool albumart_cache_get_key(int fd, const char *path,
+                            const struct mp3_albumart *aa,
+                            const struct dim *dim,
+                            struct albumart_cache_key *key)
+{
+    unsigned char head[512];
+    off_t pos = aa ? aa->pos : 0;
+
+    memset(key, 0, sizeof(*key));
+    key->path_crc = crc_32(path, strlen(path), 0xffffffff);
+    key->src_size = aa ? (uint32_t)aa->size : (uint32_t)filesize(fd);
+    key->src_pos = pos;
+    key->width = dim->width;
+    key->height = dim->height;
+#ifdef LCD_PIXELFORMAT
+    key->lcd_format = (LCD_PIXELFORMAT << 8) | LCD_DEPTH;
+#else
+    key->lcd_format = LCD_DEPTH;
+#endif
+
+    ssize_t len = -1;
+    if (lseek(fd, pos, SEEK_SET) == pos)
+        len = read(fd, head, sizeof(head));
+    lseek(fd, 0, SEEK_SET);
+    if (len <= 0)
+        return false;
+
+    key->head_crc = crc_32(head, len, 0xffffffff);
+    return true;
+}
+
+int albumart_cache_load(const struct albumart_cache_key *key,
+                        struct bitmap *bm, size_t maxsize)
+{
+    struct albumart_cache_header hdr;
+    char path[MAX_PATH];
+    int rc = -1;
+
+    albumart_cache_path(key, path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    if (read(fd, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+        hdr.magic == ALBUMART_CACHE_MAGIC &&
+        !memcmp(&hdr.key, key, sizeof(*key)) &&
+        hdr.size <= maxsize &&
+        read(fd, bm->data, hdr.size) == (ssize_t)hdr.size)
+    {
+        bm->width = hdr.width;
+        bm->height = hdr.height;
+#if (LCD_DEPTH > 1) || defined(HAVE_REMOTE_LCD) && (LCD_REMOTE_DEPTH > 1)
+        bm->format = hdr.format;
+#endif
+#ifdef HAVE_LCD_COLOR
+        bm->alpha_offset = hdr.alpha_offset;
+#endif
+        rc = hdr.size;
+        logf("Album art cache hit: %s", path);
+    }
+
+    close(fd);
+    return rc;
+}
+
+void albumart_cache_store(const struct albumart_cache_key *key,
+                          const struct bitmap *bm, size_t size)
+{
+    struct albumart_cache_header hdr;
+    char path[MAX_PATH];
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = ALBUMART_CACHE_MAGIC;
+    hdr.key = *key;
+    hdr.width = bm->width;
+    hdr.height = bm->height;
+#if (LCD_DEPTH > 1) || defined(HAVE_REMOTE_LCD) && (LCD_REMOTE_DEPTH > 1)
+    hdr.format = bm->format;
+#endif
+#ifdef HAVE_LCD_COLOR
+    hdr.alpha_offset = bm->alpha_offset;
+#endif
+    hdr.size = size;
+
+    albumart_cache_path(key, path, sizeof(path));
+    int fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    if (fd < 0 && mkdir(ALBUMART_CACHE_DIR) == 0)
+        fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    if (fd < 0)
+        return;
+
+    bool ok = write(fd, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+              write(fd, bm->data, size) == (ssize_t)size;
+    close(fd);
+    /* don't leave a partial image behind for the next load */
+    if (!ok)
+        remove(path);
+}
+
 #endif /* PLUGIN */
@@ -40,6 +40,33 @@ bool search_albumart_files(const struct mp3entry *id3, const char *size_string,
 
 void get_albumart_size(struct bitmap *bmp);
 
+#ifndef PLUGIN
+/* Album art decoded and scaled for a given size is kept in native LCD
+ * format under ALBUMART_CACHE_DIR, so loading it again for another track of
+ * the same album (or after a reboot) is a plain read instead of a decode. */
+struct albumart_cache_key {
+    uint32_t path_crc;   /* file holding the image */
+    uint32_t head_crc;   /* first sector of the image data */
+    uint32_t src_size;   /* size of the file or the embedded image */
+    uint32_t src_pos;    /* offset of an embedded image */
+    uint16_t width;      /* requested dimensions */
+    uint16_t height;
+    uint32_t lcd_format; /* depth and pixel format of the cached data */
+};
+
+/* Fill in the key for the image in fd and rewind fd. Returns false if the
+ * image can't be identified, in which case it shouldn't be cached. */
+bool albumart_cache_get_key(int fd, const char *path,
+                            const struct mp3_albumart *aa,
+                            const struct dim *dim,
+                            struct albumart_cache_key *key);
+/* Returns the size of the bitmap data read into bm->data or < 0 */
+int albumart_cache_load(const struct albumart_cache_key *key,
+                        struct bitmap *bm, size_t maxsize);
+void albumart_cache_store(const struct albumart_cache_key *key,
+                          const struct bitmap *bm, size_t size);
+#endif /* PLUGIN */
+
 #endif /* HAVE_ALBUMART */
 
 #endif /* _ALBUMART_H_ */
@@ -26,6 +26,8 @@
 * KIND, either express or implied.
 *
 ****************************************************************************/
+/* only the byte order helpers are wanted, keep file reads unbuffered */
+#define METADATA_STREAM_NO_REDIRECT
 #include "metadata_common.h"
 #include "plugin.h"
 #include "debug.h"
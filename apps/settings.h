@@ -411,6 +411,9 @@ struct user_settings
 #ifdef HAVE_PITCHCONTROL
     bool timestretch_enabled;
 #endif
+#ifdef HAVE_RESAMPLE_SINC
+    bool resample_sinc;     /* windowed-sinc resampling */
+#endif
 
 #ifdef HAVE_RECORDING
     int rec_format;    /* record format index */
@@ -925,6 +928,7 @@ struct user_settings
     int hp_lo_select; /* indicates automatic, headphone-only, or lineout-only operation */
 #endif
     bool playback_log; /* ROCKBOX_DIR/playback.log for tracks played */
+    int metadata_prefetch; /* tracks to parse metadata for in one pass */
 };
 
 /* global settings */
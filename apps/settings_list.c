@@ -1736,6 +1736,10 @@ const struct settings_list settings[] = {
     /* dithering */
     OFFON_SETTING(F_SOUNDSETTING, dithering_enabled, LANG_DITHERING, false,
                   "dithering enabled", dsp_dither_enable),
+#ifdef HAVE_RESAMPLE_SINC
+    OFFON_SETTING(F_SOUNDSETTING, resample_sinc, LANG_RESAMPLE_SINC, false,
+                  "high quality resampling", dsp_resample_sinc_enable),
+#endif
     /* surround */
      TABLE_SETTING(F_TIME_SETTING | F_SOUNDSETTING, surround_enabled,
                   LANG_SURROUND, 0, "surround enabled", off,
@@ -1999,6 +2003,9 @@ const struct settings_list settings[] = {
 #endif
     OFFON_SETTING(F_BANFROMQS,cuesheet,LANG_CUESHEET_ENABLE,false,"cuesheet support",
                   NULL),
+    INT_SETTING(F_BANFROMQS, metadata_prefetch, LANG_METADATA_PREFETCH, 0,
+                "metadata prefetch", UNIT_INT, 0, AUDIO_PREFETCH_MAX, 1,
+                formatter_unit_0_is_off, getlang_unit_0_is_off, NULL),
     TABLE_SETTING_LIST(F_TIME_SETTING | F_ALLOW_ARBITRARY_VALS, skip_length,
                   LANG_SKIP_LENGTH, 0, "skip length",
                   "outro,track",
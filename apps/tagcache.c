@@ -67,6 +67,12 @@
 #include <unistd.h> /* readlink() */
 #include <limits.h> /* PATH_MAX */
 #endif
+#if defined(__PCTOOL__) && !defined(WIN32)
+/* The database tool parses metadata in worker processes. */
+#define TAGCACHE_BUILD_JOBS
+#include <unistd.h> /* fork() */
+#include <sys/wait.h> /* waitpid() */
+#endif
 #include "config.h"
 #include "ata_idle_notify.h"
 #include "thread.h"
@@ -115,8 +121,11 @@
 /* Tag Cache Header version 'TCHxx'. Increment when changing internal structures. */
 #define TAGCACHE_MAGIC  0x54434810
 
+/* Filename hash index version 'TCFxx'. Increment when changing the hash. */
+#define TAGCACHE_FNHASH_MAGIC 0x54434601
+
 /* Dump store/restore header version 'TCSxx'. */
-#define TAGCACHE_STATEFILE_MAGIC 0x54435301
+#define TAGCACHE_STATEFILE_MAGIC 0x54435303
 
 /* How much to allocate extra space for ramcache. */
 #define TAGCACHE_RESERVE 32768
@@ -154,6 +163,18 @@
 /* Serialized DB. */
 #define TAGCACHE_STATEFILE       "database_state.tcd"
 
+/* Filename hash index, rebuilt on every commit. */
+#define TAGCACHE_FILE_FNHASH     "database_fnhash.tcd"
+
+/* Filename hash slots read at once when probing on disk. */
+#define FNHASH_READ_SLOTS 8
+
+/* Per-tag inverted lists from tag entries to master index entries. */
+#define TAGCACHE_FILE_INVLIST    "database_inv_%d.tcd"
+
+/* Records buffered when writing the inverted lists. */
+#define INVLIST_WRITE_DEPTH 32
+
 /* Flags */
 #define FLAG_DELETED     0x0001  /* Entry has been removed from db */
 #define FLAG_DIRCACHE    0x0002  /* Filename is a dircache pointer */
@@ -311,6 +332,36 @@ struct master_header {
 
 static struct master_header current_tcmh;
 
+/* Header of the auxiliary index files derived from the master index at
+ * commit. They are only valid for the commit that created them; lookups
+ * fall back to scanning the database otherwise. */
+struct aux_header {
+    int32_t magic;       /* Master header magic or the file's own magic */
+    int32_t commitid;    /* Master header commitid when built */
+    int32_t entry_count; /* Master header entry count when built */
+    int32_t count;       /* Number of records following the header */
+};
+
+/* The filename hash index is an open addressing table with linear probing
+ * mapping the crc32 of a lowercased path to its master index entry. */
+struct fnhash_slot {
+    uint32_t hash;       /* crc32 of the lowercased path */
+    int32_t idx_id;      /* Master index entry, -1 if the slot is empty */
+};
+
+/* An inverted list file holds one key per tag entry in use, sorted by seek,
+ * followed by the ascending master index ids each key refers to. */
+struct invlist_key {
+    int32_t seek;        /* Tag entry offset as found in tag_seek[] */
+    int32_t first;       /* First id belonging to this key */
+    int32_t count;       /* Number of ids belonging to this key */
+};
+
+struct invlist_pair {
+    int32_t seek;
+    int32_t idx_id;
+};
+
 #ifdef HAVE_TC_RAMCACHE
 
 #define TC_ALIGN_PTR(p, type, gap_out_p) \
@@ -331,6 +382,10 @@ static struct master_header current_tcmh;
 struct ramcache_header {
     char *tags[TAG_COUNT];       /* Tag file content (dcfrefs if tag_filename) */
     int entry_count[TAG_COUNT];  /* Number of entries in the indices. */
+#ifdef HAVE_DIRCACHE
+    struct fnhash_slot *fnhash;  /* Filename hash index (NULL if not loaded) */
+    int fnhash_slots;            /* Number of slots in fnhash */
+#endif
     struct index_entry indices[0]; /* Master index file content */
 };
 
@@ -399,11 +454,25 @@ static int total_entry_count = 0;
 static int data_size = 0;
 static int processed_dir_count;
 
+#ifdef TAGCACHE_BUILD_JOBS
+/* Files waiting for their metadata to be parsed by the build jobs. */
+struct build_file {
+    char *path;
+    unsigned long mtime;
+};
+
+static struct build_file *build_files;
+static int build_file_count, build_file_capacity;
+static int build_jobs = 1;
+#endif /* TAGCACHE_BUILD_JOBS */
+
 /* Thread safe locking */
 static volatile int write_lock;
 static volatile int read_lock;
 
 static bool delete_entry(long idx_id);
+static bool get_index(int masterfd, int idxid,
+                      struct index_entry *idx, bool use_ram);
 
 static inline void str_setlen(char *buf, size_t len)
 {
@@ -681,6 +750,7 @@ static void remove_files(void)
     tc_stat.ramcache = false;
     tc_stat.econ = false;
     remove_db_file(TAGCACHE_FILE_MASTER);
+    remove_db_file(TAGCACHE_FILE_FNHASH);
     for (i = 0; i < TAG_COUNT; i++)
     {
         if (TAGCACHE_IS_NUMERIC(i))
@@ -689,6 +759,13 @@ static void remove_files(void)
         snprintf(buf, bufsz, "%s/" TAGCACHE_FILE_INDEX,
                  tc_stat.db_path, i);
         remove(buf);
+
+        if (TAGCACHE_IS_UNIQUE(i))
+        {
+            snprintf(buf, bufsz, "%s/" TAGCACHE_FILE_INVLIST,
+                     tc_stat.db_path, i);
+            remove(buf);
+        }
     }
 }
 
@@ -748,6 +825,32 @@ static bool update_master_header(void)
     return true;
 }
 
+static inline long fnhash_slot_count(long entry_count)
+{
+    /* Keep the load factor at about 2/3 */
+    return entry_count + entry_count / 2 + 1;
+}
+
+/* Case-folded so that a path differing only in case from the stored one
+ * lands on the same chain */
+static uint32_t fnhash_hash(const char *filename)
+{
+    char folded[MAX_PATH];
+    uint32_t crc32 = 0xffffffff;
+
+    do
+    {
+        size_t len = 0;
+        while (len < sizeof (folded) && *filename)
+            folded[len++] = tolower((unsigned char)*filename++);
+
+        crc32 = crc_32(folded, len, crc32);
+    }
+    while (*filename);
+
+    return crc32;
+}
+
 #if !defined(PLUGIN)
 #ifndef __PCTOOL__
 static bool do_timed_yield(void)
@@ -764,6 +867,46 @@ static bool do_timed_yield(void)
 }
 #endif /* __PCTOOL__ */
 
+#ifdef __PCTOOL__
+/* Estimate the commit buffer needed for the current and the pending
+ * database, so large libraries don't run out of buffer on the host. */
+static size_t host_tempbuf_size(void)
+{
+    struct master_header tcmh;
+    struct tagcache_header tch;
+    size_t entries = 0, datasize = 0;
+    int fd;
+
+    fd = open_db_fd(TAGCACHE_FILE_MASTER, O_RDONLY);
+    if (fd >= 0)
+    {
+        if (read_master_header(fd, &tcmh) == sizeof(struct master_header))
+        {
+            entries += tcmh.tch.entry_count;
+            datasize += tcmh.tch.datasize;
+        }
+        close(fd);
+    }
+
+    fd = open_db_fd(TAGCACHE_FILE_TEMP, O_RDONLY);
+    if (fd >= 0)
+    {
+        if (read_tagcache_header(fd, &tch) == sizeof(struct tagcache_header))
+        {
+            entries += tch.entry_count;
+            datasize += tch.datasize;
+        }
+        close(fd);
+    }
+
+    /* build_index() keeps an index, crc, id list and two lookup slots per
+     * entry, plus the strings and a lookup slot per chunk of tag data. */
+    return entries * (sizeof(struct tempbuf_searchidx) +
+                      sizeof(struct tempbuf_id_list) + 2*sizeof(void *) + 4)
+           + datasize * (1 + sizeof(void *)) + 1024*1024;
+}
+#endif /* __PCTOOL__ */
+
 static void allocate_tempbuf(void)
 {
     /* Yeah, malloc would be really nice now :) */
@@ -771,7 +914,7 @@ static void allocate_tempbuf(void)
     tempbuf_size = 0;
 
 #ifdef __PCTOOL__
-    size = 32*1024*1024;
+    size = MAX((size_t)32*1024*1024, host_tempbuf_size());
     tempbuf = malloc(size);
     if (tempbuf)
         tempbuf_size = size;
@@ -802,7 +945,57 @@ static void free_tempbuf(void)
     tempbuf_size = 0;
 }
 
+static bool aux_header_valid_magic(const struct aux_header *hdr,
+                                   int32_t magic)
+{
+    return hdr->magic == magic
+        && hdr->commitid == current_tcmh.commitid
+        && hdr->entry_count == current_tcmh.tch.entry_count;
+}
+
+static bool aux_header_valid(const struct aux_header *hdr)
+{
+    return aux_header_valid_magic(hdr, TAGCACHE_MAGIC);
+}
+
+static bool fnhash_header_valid(const struct aux_header *fhh)
+{
+    return aux_header_valid_magic(fhh, TAGCACHE_FNHASH_MAGIC)
+        && fhh->count == fnhash_slot_count(fhh->entry_count);
+}
+
 #if defined(HAVE_TC_RAMCACHE) && defined(HAVE_DIRCACHE)
+/* Look up the dircache reference through the filename hash index. */
+static long find_entry_ram_hash(const char *filename,
+                                const struct dircache_fileref *dcfrefp)
+{
+    const struct fnhash_slot *slots = tcramcache.hdr->fnhash;
+    long slot_count = tcramcache.hdr->fnhash_slots;
+
+    if (!slots)
+        return -1;
+
+    uint32_t hash = fnhash_hash(filename);
+    long slot = hash % slot_count;
+
+    for (long probes = 0; probes < slot_count; probes++)
+    {
+        long idx_id = slots[slot].idx_id;
+        if (idx_id < 0)
+            break;
+
+        if (slots[slot].hash == hash &&
+            (tcramcache.hdr->indices[idx_id].flag & FLAG_DIRCACHE) &&
+            dircache_fileref_cmp(&tcrc_dcfrefs[idx_id], dcfrefp) >= 3)
+            return idx_id;
+
+        if (++slot >= slot_count)
+            slot = 0;
+    }
+
+    return -1;
+}
+
 /* find the ramcache entry corresponding to the file indicated by
  * filename and dc (it's corresponding dircache id). */
 static long find_entry_ram(const char *filename)
@@ -822,6 +1015,18 @@ static long find_entry_ram(const char *filename)
         return -1;
     }
 
+    /* A loaded hash index covers every entry. The caller's path may be
+       spelled differently from the stored one ("//", "..", case), so hash
+       the path dircache rebuilds for the file, which is the spelling the
+       database was built from. */
+    if (tcramcache.hdr->fnhash)
+    {
+        char path[MAX_PATH];
+        ssize_t len = dircache_get_fileref_path(&dcfref, path, sizeof (path));
+        if (len >= 0 && (size_t)len < sizeof (path))
+            return find_entry_ram_hash(path, &dcfref);
+    }
+
     /* Search references */
     int end_pos = current_tcmh.tch.entry_count;
     while (1)
@@ -855,6 +1060,99 @@ static long find_entry_ram(const char *filename)
 }
 #endif /* defined (HAVE_TC_RAMCACHE) && defined (HAVE_DIRCACHE) */
 
+/* Check that the master index entry idx_id still refers to filename. */
+static bool fnhash_check_disk(int fd, long idx_id,
+                              const char *filename, long tag_length)
+{
+    struct index_entry idx;
+    struct tagfile_entry tfe;
+    char buf[TAGCACHE_BUFSZ];
+
+    if (tag_length > (long)sizeof(buf))
+        return false;
+
+    if (!get_index(-1, idx_id, &idx, true))
+        return false;
+
+    if (lseek(fd, idx.tag_seek[tag_filename], SEEK_SET) < 0)
+        return false;
+
+    if (read_tagfile_entry(fd, &tfe) != sizeof(struct tagfile_entry)
+        || tfe.idx_id != idx_id || tfe.tag_length != tag_length)
+        return false;
+
+    if (read(fd, buf, tag_length) != tag_length)
+        return false;
+
+    return !strncmp(filename, buf, tag_length);
+}
+
+/* Look up filename through the filename hash index on disk. Returns the
+ * index id, -1 if the file isn't in the database or -2 if the hash index
+ * is missing or stale. fd is the filename tag file. */
+static long find_entry_disk_hash(int fd, const char *filename, long tag_length)
+{
+    struct aux_header fhh;
+    struct fnhash_slot slots[FNHASH_READ_SLOTS];
+    long idx_id = -2;
+
+    int hashfd = open_db_fd(TAGCACHE_FILE_FNHASH, O_RDONLY);
+    if (hashfd < 0)
+        return -2;
+
+    if (read(hashfd, &fhh, sizeof(fhh)) != sizeof(fhh)
+        || !fnhash_header_valid(&fhh))
+    {
+        logf("filename hash stale");
+        goto out;
+    }
+
+    uint32_t hash = fnhash_hash(filename);
+    long slot = hash % fhh.count;
+    int i = 0, count = 0;
+
+    for (long probes = 0; probes < fhh.count; probes++)
+    {
+        if (i >= count)
+        {
+            count = MIN(FNHASH_READ_SLOTS, fhh.count - slot);
+            ssize_t size = count * sizeof(struct fnhash_slot);
+
+            lseek(hashfd, sizeof(fhh) + slot * sizeof(struct fnhash_slot),
+                  SEEK_SET);
+            if (read(hashfd, slots, size) != size)
+            {
+                logf("filename hash read error");
+                idx_id = -2;
+                goto out;
+            }
+
+            i = 0;
+        }
+
+        idx_id = slots[i].idx_id;
+        if (idx_id < 0)
+            break;
+
+        if (slots[i].hash == hash &&
+            fnhash_check_disk(fd, idx_id, filename, tag_length))
+            goto out;
+
+        i++;
+
+        if (++slot >= fhh.count)
+        {
+            slot = 0;
+            i = count;
+        }
+    }
+
+    idx_id = -1;
+out:
+    close(hashfd);
+    return idx_id;
+}
+
 static long find_entry_disk(const char *filename_raw, bool localfd)
 {
     struct tagfile_entry tfe;
@@ -892,6 +1190,23 @@ static long find_entry_disk(const char *filename_raw, bool localfd)
             return -1;
     }
 
+    long tag_length = strlen(filename) + 1; /* include NULL */
+
+    /* A valid hash index answers for the whole database */
+    idx = find_entry_disk_hash(fd, filename, tag_length);
+    if (idx != -2)
+    {
+        if (idx < 0)
+            idx = -4;
+
+        if (fd != filenametag_fd || localfd)
+            close(fd);
+
+        return idx;
+    }
+
+    idx = -1;
+
     check_again:
 
     if (last_pos > 0) /* pos gets cached to prevent reading from beginning */
@@ -899,8 +1214,6 @@ static long find_entry_disk(const char *filename_raw, bool localfd)
     else /* start back at beginning */
         pos = lseek(fd, sizeof(struct tagcache_header), SEEK_SET);
 
-    long tag_length = strlen(filename) + 1; /* include NULL */
-
     if (tag_length < bufsz)
     {
         while (true)
@@ -1624,10 +1937,47 @@ static bool add_uniqbuf(struct tagcache_search *tcs, uint32_t id)
     return true;
 }
 
+/* Add the entry to the seek list if it passes the filters, the clauses and
+ * the uniq buffer. Doesn't yield. */
+static bool add_seeklist_entry(struct tagcache_search *tcs,
+                               struct index_entry *idx, int idx_id)
+{
+    struct tagcache_seeklist_entry *seeklist;
+    int i;
+
+    /* Skip deleted files. */
+    if (idx->flag & FLAG_DELETED)
+        return false;
+
+    /* Go through all filters.. */
+    for (i = 0; i < tcs->filter_count; i++)
+    {
+        if (idx->tag_seek[tcs->filter_tag[i]] != tcs->filter_seek[i])
+            return false;
+    }
+
+    /* Check for conditions. */
+    if (!check_clauses(tcs, idx, tcs->clause, tcs->clause_count))
+        return false;
+
+    /* Add to the seek list if not already in uniq buffer. */
+    if (!add_uniqbuf(tcs, idx->tag_seek[tcs->type]))
+        return false;
+
+    /* Lets add it. */
+    seeklist = &tcs->seeklist[tcs->seek_list_count];
+    seeklist->seek = idx->tag_seek[tcs->type];
+    seeklist->flag = idx->flag;
+    seeklist->idx_id = idx_id;
+    tcs->seek_list_count++;
+
+    return true;
+}
+
 static bool build_lookup_list(struct tagcache_search *tcs)
 {
     struct index_entry entry;
-    int i, j;
+    int i;
 
     tcs->seek_list_count = 0;
 
@@ -1638,41 +1988,11 @@ static bool build_lookup_list(struct tagcache_search *tcs)
 
         for (i = tcs->seek_pos; i < current_tcmh.tch.entry_count; i++)
         {
-            struct tagcache_seeklist_entry *seeklist;
-            /* idx points to movable data, don't yield or reload */
-            struct index_entry *idx = &tcramcache.hdr->indices[i];
             if (tcs->seek_list_count == SEEK_LIST_SIZE)
                 break ;
 
-            /* Skip deleted files. */
-            if (idx->flag & FLAG_DELETED)
-                continue;
-
-            /* Go through all filters.. */
-            for (j = 0; j < tcs->filter_count; j++)
-            {
-                if (idx->tag_seek[tcs->filter_tag[j]] != tcs->filter_seek[j])
-                {
-                    break ;
-                }
-            }
-
-            if (j < tcs->filter_count)
-                continue ;
-
-            /* Check for conditions. */
-            if (!check_clauses(tcs, idx, tcs->clause, tcs->clause_count))
-                continue;
-            /* Add to the seek list if not already in uniq buffer (doesn't yield)*/
-            if (!add_uniqbuf(tcs, idx->tag_seek[tcs->type]))
-                continue;
-
-            /* Lets add it. */
-            seeklist = &tcs->seeklist[tcs->seek_list_count];
-            seeklist->seek = idx->tag_seek[tcs->type];
-            seeklist->flag = idx->flag;
-            seeklist->idx_id = i;
-            tcs->seek_list_count++;
+            /* idx points to movable data, don't yield or reload */
+            add_seeklist_entry(tcs, &tcramcache.hdr->indices[i], i);
         }
 
         tcrc_buffer_unlock();
@@ -1689,49 +2009,51 @@ static bool build_lookup_list(struct tagcache_search *tcs)
         tcs->masterfd = open_master_fd(&tcmh, false);
     }
 
+    if (tcs->invlist_fd >= 0)
+    {
+        /* Only visit the entries listed for the narrowest filter. */
+        while (tcs->invlist_count > 0
+               && tcs->seek_list_count < SEEK_LIST_SIZE)
+        {
+            int32_t idx_id;
+
+            tcs->invlist_count--;
+            if (read(tcs->invlist_fd, &idx_id, sizeof(idx_id)) != sizeof(idx_id))
+            {
+                logf("inverted list read error");
+                tcs->invlist_count = 0;
+                break;
+            }
+
+            lseek(tcs->masterfd, idx_id * sizeof(struct index_entry) +
+                    sizeof(struct master_header), SEEK_SET);
+            if (read_index_entries(tcs->masterfd, &entry, 1) !=
+                    sizeof(struct index_entry))
+            {
+                tcs->invlist_count = 0;
+                break;
+            }
+
+            if (add_seeklist_entry(tcs, &entry, idx_id))
+                yield();
+        }
+
+        return tcs->seek_list_count > 0;
+    }
+
     lseek(tcs->masterfd, tcs->seek_pos * sizeof(struct index_entry) +
             sizeof(struct master_header), SEEK_SET);
 
     while (read_index_entries(tcs->masterfd, &entry, 1) == sizeof(struct index_entry))
     {
-        struct tagcache_seeklist_entry *seeklist;
-
         if (tcs->seek_list_count == SEEK_LIST_SIZE)
             break ;
 
         i = tcs->seek_pos;
         tcs->seek_pos++;
 
-        /* Check if entry has been deleted. */
-        if (entry.flag & FLAG_DELETED)
-            continue;
-
-        /* Go through all filters.. */
-        for (j = 0; j < tcs->filter_count; j++)
-        {
-            if (entry.tag_seek[tcs->filter_tag[j]] != tcs->filter_seek[j])
-                break ;
-        }
-
-        if (j < tcs->filter_count)
-            continue ;
-
-        /* Check for conditions. */
-        if (!check_clauses(tcs, &entry, tcs->clause, tcs->clause_count))
-            continue;
-
-        /* Add to the seek list if not already in uniq buffer. */
-        if (!add_uniqbuf(tcs, entry.tag_seek[tcs->type]))
-            continue;
-
-        /* Lets add it. */
-        seeklist = &tcs->seeklist[tcs->seek_list_count];
-        seeklist->seek = entry.tag_seek[tcs->type];
-        seeklist->flag = entry.flag;
-        seeklist->idx_id = i;
-        tcs->seek_list_count++;
-
-        yield();
+        if (add_seeklist_entry(tcs, &entry, i))
+            yield();
     }
 
     return tcs->seek_list_count > 0;
@@ -1749,6 +2071,7 @@ bool tagcache_search(struct tagcache_search *tcs, int tag)
         sleep(1);
 
     memset(tcs, 0, sizeof(struct tagcache_search));
+    tcs->invlist_fd = -1;
     if (tc_stat.commit_step > 0 || !tc_stat.ready)
         return false;
 
@@ -1810,6 +2133,59 @@ void tagcache_search_set_uniqbuf(struct tagcache_search *tcs,
     memset(tcs->unique_list, 0, tcs->unique_list_capacity);
 }
 
+/* Find the inverted list of the tag entry at seek. On success fd is left at
+ * the first index id of the list and the number of ids is returned. */
+static int open_invlist(int tag, int32_t seek, int *fdp)
+{
+    struct aux_header ih;
+    struct invlist_key key;
+    char fname[MAX_PATH];
+    long lo, hi;
+    int fd;
+
+    fd = open_pathfmt(fname, sizeof(fname), O_RDONLY,
+                      "%s/" TAGCACHE_FILE_INVLIST, tc_stat.db_path, tag);
+    if (fd < 0)
+        return -1;
+
+    if (read(fd, &ih, sizeof(ih)) != sizeof(ih) || !aux_header_valid(&ih))
+    {
+        close(fd);
+        return -1;
+    }
+
+    lo = 0;
+    hi = ih.count - 1;
+    while (lo <= hi)
+    {
+        long mid = (lo + hi) / 2;
+
+        lseek(fd, sizeof(ih) + mid * sizeof(key), SEEK_SET);
+        if (read(fd, &key, sizeof(key)) != sizeof(key))
+        {
+            close(fd);
+            return -1;
+        }
+
+        if (key.seek == seek)
+        {
+            lseek(fd, sizeof(ih) + ih.count * sizeof(key)
+                  + key.first * sizeof(int32_t), SEEK_SET);
+            *fdp = fd;
+            return key.count;
+        }
+
+        if (key.seek < seek)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+
+    /* No entry refers to this seek */
+    *fdp = fd;
+    return 0;
+}
+
 bool tagcache_search_add_filter(struct tagcache_search *tcs,
                                 int tag, int seek)
 {
@@ -1823,6 +2199,28 @@ bool tagcache_search_add_filter(struct tagcache_search *tcs,
     tcs->filter_seek[tcs->filter_count] = seek;
     tcs->filter_count++;
 
+    /* Disk searches walk the shortest inverted list instead of the whole
+     * master index. The ram copy is cheap enough to scan. */
+    if (!tcs->ramsearch)
+    {
+        int fd;
+        int count = open_invlist(tag, seek, &fd);
+
+        if (count >= 0)
+        {
+            if (tcs->invlist_fd < 0 || count < tcs->invlist_count)
+            {
+                if (tcs->invlist_fd >= 0)
+                    close(tcs->invlist_fd);
+
+                tcs->invlist_fd = fd;
+                tcs->invlist_count = count;
+            }
+            else
+                close(fd);
+        }
+    }
+
     return true;
 }
 
@@ -2063,6 +2461,12 @@ void tagcache_search_finish(struct tagcache_search *tcs)
         tcs->masterfd = -1;
     }
 
+    if (tcs->invlist_fd >= 0)
+    {
+        close(tcs->invlist_fd);
+        tcs->invlist_fd = -1;
+    }
+
     for (i = 0; i < TAG_COUNT; i++)
     {
         if (tcs->idxfd[i] >= 0)
@@ -2207,23 +2611,15 @@ static int check_if_empty(char **tag)
  * idea, as it uses lots of stack and is called from a recursive function
  * (check_dir).
  */
+static void NO_INLINE add_tagcache_entry(char *path, unsigned long mtime);
+#ifdef TAGCACHE_BUILD_JOBS
+static bool queue_build_file(const char *path, unsigned long mtime);
+#endif
+
 static void NO_INLINE add_tagcache(char *path, unsigned long mtime)
 {
-    #define ADD_TAG(entry, tag, data) \
-        /* Adding tag */                              \
-        entry.tag_length[tag] = check_if_empty(data); \
-        entry.tag_offset[tag] = offset;               \
-        offset += entry.tag_length[tag]
-
-    struct mp3entry id3;
-    struct temp_file_entry entry;
-    bool ret;
     int idx_id = -1;
-    char tracknumfix[3];
-    int offset = 0;
     int path_length = strlen(path);
-    bool has_artist;
-    bool has_grouping;
 
 #ifdef SIMULATOR
     /* Crude logging for the sim - to aid in debugging */
@@ -2281,14 +2677,40 @@ static void NO_INLINE add_tagcache(char *path, unsigned long mtime)
             return ;
         }
 
-        /* Metadata might have been changed. Delete the entry. */
-        logf("Re-adding: %s", path);
-        if (!delete_entry(idx_id))
-        {
-            logf("delete_entry failed: %d", idx_id);
-            return ;
-        }
-    }
+        /* Metadata might have been changed. Delete the entry. */
+        logf("Re-adding: %s", path);
+        if (!delete_entry(idx_id))
+        {
+            logf("delete_entry failed: %d", idx_id);
+            return ;
+        }
+    }
+
+#ifdef TAGCACHE_BUILD_JOBS
+    if (build_jobs > 1 && queue_build_file(path, mtime))
+        return ;
+#endif
+
+    add_tagcache_entry(path, mtime);
+}
+
+/* Read the metadata of a new or modified file and write it out to the
+ * temporary db file. */
+static void NO_INLINE add_tagcache_entry(char *path, unsigned long mtime)
+{
+    #define ADD_TAG(entry, tag, data) \
+        /* Adding tag */                              \
+        entry.tag_length[tag] = check_if_empty(data); \
+        entry.tag_offset[tag] = offset;               \
+        offset += entry.tag_length[tag]
+
+    struct mp3entry id3;
+    struct temp_file_entry entry;
+    bool ret;
+    char tracknumfix[3];
+    int offset = 0;
+    bool has_artist;
+    bool has_grouping;
 
     /*memset(&id3, 0, sizeof(struct mp3entry)); -- get_metadata does this for us */
     memset(&entry, 0, sizeof(struct temp_file_entry));
@@ -2381,6 +2803,183 @@ static void NO_INLINE add_tagcache(char *path, unsigned long mtime)
 
     #undef ADD_TAG
 }
+
+#ifdef __PCTOOL__
+void tagcache_set_build_jobs(int jobs)
+{
+#ifdef TAGCACHE_BUILD_JOBS
+    build_jobs = MAX(jobs, 1);
+#else
+    (void)jobs;
+#endif
+}
+#endif /* __PCTOOL__ */
+
+#ifdef TAGCACHE_BUILD_JOBS
+static bool queue_build_file(const char *path, unsigned long mtime)
+{
+    if (build_file_count == build_file_capacity)
+    {
+        int capacity = MAX(build_file_capacity * 2, 1024);
+        struct build_file *files =
+            realloc(build_files, capacity * sizeof(struct build_file));
+        if (!files)
+            return false;
+
+        build_files = files;
+        build_file_capacity = capacity;
+    }
+
+    char *copy = strdup(path);
+    if (!copy)
+        return false;
+
+    build_files[build_file_count].path = copy;
+    build_files[build_file_count].mtime = mtime;
+    build_file_count++;
+
+    return true;
+}
+
+static void free_build_files(void)
+{
+    for (int i = 0; i < build_file_count; i++)
+        free(build_files[i].path);
+
+    free(build_files);
+    build_files = NULL;
+    build_file_count = build_file_capacity = 0;
+}
+
+/* Parse the queued files [first, last) into a temporary db file of their
+ * own. This runs in a child process, so the metadata parsers and the file
+ * layer don't need to be thread safe. */
+static void NORETURN_ATTR build_job(int job, int first, int last)
+{
+    struct tagcache_header header;
+    char name[MAX_PATH];
+
+    snprintf(name, sizeof(name), TAGCACHE_FILE_TEMP ".%d", job);
+    cachefd = open_db_fd(name, O_RDWR | O_CREAT | O_TRUNC);
+    if (cachefd < 0)
+        _exit(1);
+
+    memset(&header, 0, sizeof(struct tagcache_header));
+    write(cachefd, &header, sizeof(struct tagcache_header));
+
+    data_size = 0;
+    total_entry_count = 0;
+    for (int i = first; i < last; i++)
+        add_tagcache_entry(build_files[i].path, build_files[i].mtime);
+
+    header.magic = TAGCACHE_MAGIC;
+    header.datasize = data_size;
+    header.entry_count = total_entry_count;
+    lseek(cachefd, 0, SEEK_SET);
+    bool ok = write(cachefd, &header, sizeof(struct tagcache_header)) ==
+                sizeof(struct tagcache_header);
+    close(cachefd);
+
+    _exit(ok ? 0 : 1);
+}
+
+/* Append the output of a finished build job to the temporary db file.
+ * On failure nothing of it is left behind, so the slice can be parsed
+ * again. */
+static bool collect_build_job(int job)
+{
+    struct tagcache_header header;
+    char name[MAX_PATH];
+    bool ok = false;
+    off_t start = lseek(cachefd, 0, SEEK_CUR);
+
+    snprintf(name, sizeof(name), TAGCACHE_FILE_TEMP ".%d", job);
+    int fd = open_db_fd(name, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    if (read(fd, &header, sizeof(struct tagcache_header)) ==
+            sizeof(struct tagcache_header) && header.magic == TAGCACHE_MAGIC)
+    {
+        ssize_t rc;
+
+        /* build_idx_buf is free while scanning */
+        while ((rc = read(fd, build_idx_buf, build_idx_bufsz)) > 0)
+        {
+            if (write(cachefd, build_idx_buf, rc) != rc)
+                break;
+        }
+
+        if (rc == 0)
+        {
+            data_size += header.datasize;
+            total_entry_count += header.entry_count;
+            ok = true;
+        }
+    }
+
+    if (!ok && start >= 0 && lseek(cachefd, start, SEEK_SET) == start)
+        ftruncate(cachefd, start);
+
+    close(fd);
+    remove_db_file(name);
+    return ok;
+}
+
+/* Parse the metadata of all queued files, spreading them over the build
+ * jobs. Slices whose job fails are parsed here instead. */
+static void run_build_jobs(void)
+{
+    int jobs = MIN(build_jobs, build_file_count);
+    int first = 0;
+    pid_t *pids;
+
+    if (jobs == 0)
+        return ;
+
+    pids = malloc(jobs * sizeof(pid_t));
+    if (!pids)
+        jobs = 0;
+
+    /* The children inherit any buffered logf/stdio output */
+    fflush(NULL);
+
+    for (int job = 0; job < jobs; job++)
+    {
+        int last = first + (build_file_count - first) / (jobs - job);
+
+        pids[job] = fork();
+        if (pids[job] == 0)
+            build_job(job, first, last);
+
+        first = last;
+    }
+
+    first = 0;
+    for (int job = 0; job < jobs; job++)
+    {
+        int last = first + (build_file_count - first) / (jobs - job);
+        int status;
+
+        if (pids[job] < 0 || waitpid(pids[job], &status, 0) != pids[job]
+            || !WIFEXITED(status) || WEXITSTATUS(status) != 0
+            || !collect_build_job(job))
+        {
+            logf("build job %d failed", job);
+            for (int i = first; i < last; i++)
+                add_tagcache_entry(build_files[i].path, build_files[i].mtime);
+        }
+
+        first = last;
+    }
+
+    /* Only if the job slots couldn't be allocated */
+    for (int i = first; i < build_file_count; i++)
+        add_tagcache_entry(build_files[i].path, build_files[i].mtime);
+
+    free(pids);
+}
+#endif /* TAGCACHE_BUILD_JOBS */
 #endif /*!defined(PLUGIN)*/
 
 
@@ -3316,6 +3915,264 @@ static int build_index(int index_type, struct tagcache_header *h, int tmpfd)
     return 1;
 }
 
+/* Build the filename hash index for the freshly committed database.
+ * Failing here is harmless; lookups then scan the filename tags. */
+static void build_filename_hash(const struct master_header *tcmh)
+{
+    struct aux_header fhh;
+    struct tagcache_header tch;
+    struct tagfile_entry tfe;
+    char buf[TAGCACHE_BUFSZ];
+    long slot_count = fnhash_slot_count(tcmh->tch.entry_count);
+    size_t size = slot_count * sizeof(struct fnhash_slot);
+    struct fnhash_slot *slots = (struct fnhash_slot *)tempbuf;
+    int fd;
+
+    remove_db_file(TAGCACHE_FILE_FNHASH);
+
+    /* The index is always stored in native endianness */
+    if (tc_stat.econ || (size_t)tempbuf_size < size)
+    {
+        logf("no filename hash built");
+        return;
+    }
+
+    memset(slots, 0xff, size);
+
+    fd = open_tag_fd(&tch, tag_filename, false);
+    if (fd < 0)
+        return;
+
+    while (true)
+    {
+        int res = read_tagfile_entry_and_tag(fd, &tfe, buf, sizeof(buf));
+
+        if (res == e_ENTRY_SIZEMISMATCH)
+            break; /* EOF */
+
+        if (res != e_SUCCESS && res != e_SUCCESS_LEN_ZERO)
+        {
+            logf("filename hash read error");
+            close(fd);
+            return;
+        }
+
+        /* Deleted entries have their filename cleared */
+        if (buf[0] == '\0' || tfe.idx_id < 0
+            || tfe.idx_id >= tcmh->tch.entry_count)
+            continue;
+
+        uint32_t hash = fnhash_hash(buf);
+        long slot = hash % slot_count;
+        while (slots[slot].idx_id >= 0)
+        {
+            if (++slot >= slot_count)
+                slot = 0;
+        }
+
+        slots[slot].hash = hash;
+        slots[slot].idx_id = tfe.idx_id;
+        do_timed_yield();
+    }
+
+    close(fd);
+
+    fd = open_db_fd(TAGCACHE_FILE_FNHASH, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0)
+    {
+        logf("failed to create %s", TAGCACHE_FILE_FNHASH);
+        return;
+    }
+
+    fhh.magic = TAGCACHE_FNHASH_MAGIC;
+    fhh.commitid = tcmh->commitid;
+    fhh.entry_count = tcmh->tch.entry_count;
+    fhh.count = slot_count;
+
+    bool ok = write(fd, &fhh, sizeof(fhh)) == sizeof(fhh)
+              && write(fd, slots, size) == (ssize_t)size;
+    close(fd);
+
+    if (!ok)
+    {
+        logf("filename hash write error");
+        remove_db_file(TAGCACHE_FILE_FNHASH);
+    }
+}
+
+static void remove_invlist(int tag)
+{
+    char buf[MAX_PATH];
+
+    snprintf(buf, sizeof(buf), "%s/" TAGCACHE_FILE_INVLIST,
+             tc_stat.db_path, tag);
+    remove(buf);
+}
+
+static int compare_invlist_pairs(const void *p1, const void *p2)
+{
+    const struct invlist_pair *e1 = p1;
+    const struct invlist_pair *e2 = p2;
+
+    if (e1->seek != e2->seek)
+        return e1->seek < e2->seek ? -1 : 1;
+
+    return e1->idx_id - e2->idx_id;
+}
+
+/* Write the inverted list of a tag from its pairs sorted by seek. */
+static bool write_invlist(int tag, const struct master_header *tcmh,
+                          const struct invlist_pair *pairs, long count)
+{
+    struct aux_header lh;
+    struct invlist_key keys[INVLIST_WRITE_DEPTH];
+    int32_t ids[INVLIST_WRITE_DEPTH];
+    char fname[MAX_PATH];
+    long i, nkeys = 0;
+    int n = 0;
+    bool ok;
+    int fd;
+
+    fd = open_pathfmt(fname, sizeof(fname), O_WRONLY | O_CREAT | O_TRUNC,
+                      "%s/" TAGCACHE_FILE_INVLIST, tc_stat.db_path, tag);
+    if (fd < 0)
+    {
+        logf("failed to create " TAGCACHE_FILE_INVLIST, tag);
+        return false;
+    }
+
+    /* Invalid until the header is rewritten once the keys are counted */
+    memset(&lh, 0, sizeof(lh));
+    ok = write(fd, &lh, sizeof(lh)) == sizeof(lh);
+
+    for (i = 0; i < count && ok; i++)
+    {
+        if (i == 0 || pairs[i].seek != pairs[i-1].seek)
+        {
+            if (n == INVLIST_WRITE_DEPTH)
+            {
+                ok = write(fd, keys, sizeof(keys)) == sizeof(keys);
+                n = 0;
+            }
+
+            keys[n].seek = pairs[i].seek;
+            keys[n].first = i;
+            keys[n].count = 0;
+            n++;
+            nkeys++;
+        }
+
+        keys[n-1].count++;
+    }
+
+    if (ok && n > 0)
+        ok = write(fd, keys, n * sizeof(keys[0])) == (ssize_t)(n * sizeof(keys[0]));
+
+    for (i = 0, n = 0; i < count && ok; i++)
+    {
+        ids[n++] = pairs[i].idx_id;
+        if (n == INVLIST_WRITE_DEPTH || i == count - 1)
+        {
+            ok = write(fd, ids, n * sizeof(ids[0])) == (ssize_t)(n * sizeof(ids[0]));
+            n = 0;
+        }
+    }
+
+    if (ok)
+    {
+        lh.magic = TAGCACHE_MAGIC;
+        lh.commitid = tcmh->commitid;
+        lh.entry_count = tcmh->tch.entry_count;
+        lh.count = nkeys;
+
+        lseek(fd, 0, SEEK_SET);
+        ok = write(fd, &lh, sizeof(lh)) == sizeof(lh);
+    }
+
+    close(fd);
+    return ok;
+}
+
+/* Build the inverted lists of the uniqued tags so that filtered searches
+ * only visit the matching master index entries. As many tags as fit into
+ * the commit buffer are collected per pass over the master index. */
+static void build_invlists(const struct master_header *tcmh)
+{
+    struct index_entry idx;
+    struct invlist_pair *pairs = (struct invlist_pair *)tempbuf;
+    long count = tcmh->tch.entry_count;
+    int tags[TAG_COUNT];
+    int ntags = 0, maxtags;
+
+    for (int tag = 0; tag < TAG_COUNT; tag++)
+    {
+        if (TAGCACHE_IS_NUMERIC_OR_NONUNIQUE(tag))
+            continue;
+
+        remove_invlist(tag);
+        tags[ntags++] = tag;
+    }
+
+    /* The lists are always stored in native endianness */
+    if (tc_stat.econ || count == 0)
+        return;
+
+    maxtags = tempbuf_size / (count * sizeof(struct invlist_pair));
+    if (maxtags == 0)
+    {
+        logf("no inverted lists built");
+        return;
+    }
+
+    for (int first = 0; first < ntags; first += maxtags)
+    {
+        struct master_header myhdr;
+        int passtags = MIN(maxtags, ntags - first);
+        long live = 0;
+
+        int masterfd = open_master_fd(&myhdr, false);
+        if (masterfd < 0)
+            return;
+
+        for (long i = 0; i < count; i++)
+        {
+            if (read_index_entries(masterfd, &idx, 1) != sizeof(struct index_entry))
+            {
+                logf("inverted list read error");
+                close(masterfd);
+                return;
+            }
+
+            if (idx.flag & FLAG_DELETED)
+                continue;
+
+            for (int t = 0; t < passtags; t++)
+            {
+                struct invlist_pair *pair = &pairs[t*count + live];
+                pair->seek = idx.tag_seek[tags[first + t]];
+                pair->idx_id = i;
+            }
+
+            live++;
+            do_timed_yield();
+        }
+
+        close(masterfd);
+
+        for (int t = 0; t < passtags; t++)
+        {
+            int tag = tags[first + t];
+
+            qsort(&pairs[t*count], live, sizeof(struct invlist_pair),
+                  compare_invlist_pairs);
+            if (!write_invlist(tag, tcmh, &pairs[t*count], live))
+                remove_invlist(tag);
+
+            do_timed_yield();
+        }
+    }
+}
+
 static bool commit(void)
 {
     struct tagcache_header tch;
@@ -3490,6 +4347,9 @@ static bool commit(void)
         write_master_header(masterfd, &tcmh);
         close(masterfd);
 
+        build_filename_hash(&tcmh);
+        build_invlists(&tcmh);
+
         logf("tagcache committed");
         tagcache_commit_finalize();
 
@@ -4259,6 +5119,11 @@ static void fix_ramcache(void* old_addr, void* new_addr)
     ptrdiff_t offpos = new_addr - old_addr;
     for (int i = 0; i < TAG_COUNT; i++)
         tcramcache.hdr->tags[i] += offpos;
+#ifdef HAVE_DIRCACHE
+    if (tcramcache.hdr->fnhash)
+        tcramcache.hdr->fnhash = (struct fnhash_slot *)
+            ((char *)tcramcache.hdr->fnhash + offpos);
+#endif
 }
 
 static int move_cb(int handle, void* current, void* new)
@@ -4295,7 +5160,8 @@ static bool allocate_tagcache(void)
     size_t alloc_size = tcmh.tch.datasize + 256 + TAGCACHE_RESERVE +
         sizeof(struct ramcache_header) + TAG_COUNT*sizeof(void *);
 #ifdef HAVE_DIRCACHE
-    alloc_size += tcmh.tch.entry_count*sizeof(struct dircache_fileref);
+    alloc_size += tcmh.tch.entry_count*sizeof(struct dircache_fileref) +
+        fnhash_slot_count(tcmh.tch.entry_count)*sizeof(struct fnhash_slot);
 #endif
 
     int handle = core_alloc_ex(alloc_size, &ops);
@@ -4620,6 +5486,38 @@ static bool load_tagcache(void)
         close(fd);
     }
 
+#ifdef HAVE_DIRCACHE
+    /* The filename hash index is optional, ignore it if stale */
+    tcramcache.hdr->fnhash = NULL;
+    tcramcache.hdr->fnhash_slots = 0;
+
+    fd = open_db_fd(TAGCACHE_FILE_FNHASH, O_RDONLY);
+    if (fd >= 0)
+    {
+        struct aux_header fhh;
+        ssize_t gap;
+
+        p = TC_ALIGN_PTR(p, struct fnhash_slot, &gap);
+        bytesleft -= gap;
+
+        if (read(fd, &fhh, sizeof(fhh)) == sizeof(fhh)
+            && fnhash_header_valid(&fhh))
+        {
+            ssize_t size = fhh.count * sizeof(struct fnhash_slot);
+            if (size <= bytesleft && read(fd, p, size) == size)
+            {
+                tcramcache.hdr->fnhash = (struct fnhash_slot *)p;
+                tcramcache.hdr->fnhash_slots = fhh.count;
+                p += size;
+                bytesleft -= size;
+            }
+        }
+
+        close(fd);
+        fd = -1;
+    }
+#endif /* HAVE_DIRCACHE */
+
     tc_stat.ramcache_used = tc_stat.ramcache_allocated - bytesleft;
     logf("tagcache loaded into ram!");
     logf("utilization: %d%%", 100*tc_stat.ramcache_used / tc_stat.ramcache_allocated);
@@ -5079,6 +5977,12 @@ void do_tagcache_build(const char *path[])
     }
     free_search_roots(&roots_ll[0]);
 
+#ifdef TAGCACHE_BUILD_JOBS
+    if (ret)
+        run_build_jobs();
+    free_build_files();
+#endif
+
     /* Write the header. */
     header.magic = TAGCACHE_MAGIC;
     header.datasize = data_size;
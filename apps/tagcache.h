@@ -145,6 +145,8 @@ struct tagcache_search {
     uint32_t *unique_list;
     int unique_list_capacity;
     int unique_list_count;
+    int invlist_fd;      /* Inverted list of the narrowest filter, or -1 */
+    int invlist_count;   /* Index ids left to read from invlist_fd */
 
     /* Exported variables. */
     bool ramsearch;      /* Is ram copy of the tagcache being used. */
@@ -163,6 +165,8 @@ void tagcache_reverse_scan(void);
 /* call this directly instead of tagcache_build in order to not pull
  * on global_settings */
 void do_tagcache_build(const char *path[]);
+/* number of worker processes parsing metadata during do_tagcache_build */
+void tagcache_set_build_jobs(int jobs);
 #endif
 
 const char* tagcache_tag_to_str(int tag);
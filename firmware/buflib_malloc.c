@@ -224,6 +224,13 @@ void buflib_buffer_in(struct buflib_context *ctx, int size)
     ctx->buf -= size;
 }
 
+void buflib_get_stats(struct buflib_context *ctx, struct buflib_stats *stats)
+{
+    /* malloc() does the searching, there's nothing to count here */
+    (void)ctx;
+    memset(stats, 0, sizeof(*stats));
+}
+
 #ifdef BUFLIB_DEBUG_PRINT
 int buflib_get_num_blocks(struct buflib_context *ctx)
 {
@@ -139,6 +139,122 @@ static void check_block_length(struct buflib_context *ctx,
 static void check_block_handle(struct buflib_context *ctx,
                                union buflib_data *block);
 
+/* Account for a search that had to walk 'blocks' blocks */
+static inline void count_walk(struct buflib_context *ctx, unsigned long blocks)
+{
+    ctx->stats.walks++;
+    ctx->stats.walk_blocks += blocks;
+    if (ctx->stats.walk_max < blocks)
+        ctx->stats.walk_max = blocks;
+}
+
+#if BUFLIB_FREE_INDEX_SIZE > 0
+/* The free-block index lists the free blocks below alloc_end in address
+ * order, so that allocating and freeing needn't walk every allocation in
+ * front of them. alloc and free keep it current; anything else that
+ * reshuffles blocks marks it stale and the next user rebuilds it. When
+ * there are more free blocks than it can hold the plain walks are used
+ * instead, and another rebuild is only tried after as many lookups as
+ * the index has entries. */
+#define FREE_INDEX_STALE    (-1)
+#define FREE_INDEX_OVERFLOW (-2)
+
+static inline void free_index_stale(struct buflib_context *ctx)
+{
+    ctx->free_index_len = FREE_INDEX_STALE;
+}
+
+/* Returns true if the index is complete and may be used */
+static bool free_index_ready(struct buflib_context *ctx)
+{
+    if (ctx->free_index_len == FREE_INDEX_OVERFLOW &&
+        --ctx->free_index_retry == 0)
+        ctx->free_index_len = FREE_INDEX_STALE;
+
+    if (ctx->free_index_len == FREE_INDEX_STALE)
+    {
+        union buflib_data *block;
+        unsigned long walked = 0;
+        int len = 0;
+
+        for (block = ctx->buf_start; block < ctx->alloc_end;
+             block += abs(block->val))
+        {
+            check_block_length(ctx, block);
+            walked++;
+
+            if (block->val >= 0)
+                continue;
+
+            if (len == BUFLIB_FREE_INDEX_SIZE)
+            {
+                len = FREE_INDEX_OVERFLOW;
+                ctx->free_index_retry = BUFLIB_FREE_INDEX_SIZE;
+                break;
+            }
+
+            ctx->free_index[len++] = block;
+        }
+
+        count_walk(ctx, walked);
+        ctx->free_index_len = len;
+    }
+
+    return ctx->free_index_len >= 0;
+}
+
+/* Position of the first indexed block above 'block' */
+static int free_index_find(struct buflib_context *ctx, union buflib_data *block)
+{
+    int lo = 0, hi = ctx->free_index_len;
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (ctx->free_index[mid] <= block)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+static void free_index_remove(struct buflib_context *ctx, int i)
+{
+    ctx->free_index_len--;
+    memmove(&ctx->free_index[i], &ctx->free_index[i + 1],
+            (ctx->free_index_len - i) * sizeof (ctx->free_index[0]));
+}
+
+static void free_index_insert(struct buflib_context *ctx, int i,
+                              union buflib_data *block)
+{
+    if (ctx->free_index_len == BUFLIB_FREE_INDEX_SIZE)
+    {
+        ctx->free_index_len = FREE_INDEX_OVERFLOW;
+        ctx->free_index_retry = BUFLIB_FREE_INDEX_SIZE;
+        return;
+    }
+
+    memmove(&ctx->free_index[i + 1], &ctx->free_index[i],
+            (ctx->free_index_len - i) * sizeof (ctx->free_index[0]));
+    ctx->free_index[i] = block;
+    ctx->free_index_len++;
+}
+#else
+static inline void free_index_stale(struct buflib_context *ctx)
+{
+    (void)ctx;
+}
+
+static inline bool free_index_ready(struct buflib_context *ctx)
+{
+    (void)ctx;
+    return false;
+}
+#endif /* BUFLIB_FREE_INDEX_SIZE */
+
 /* Initialize buffer manager */
 void
 buflib_init(struct buflib_context *ctx, void *buf, size_t size)
@@ -160,6 +276,10 @@ buflib_init(struct buflib_context *ctx, void *buf, size_t size)
      */
     ctx->alloc_end = bd_buf;
     ctx->compact = true;
+#if BUFLIB_FREE_INDEX_SIZE > 0
+    ctx->free_index_len = 0;
+#endif
+    memset(&ctx->stats, 0, sizeof (ctx->stats));
 
     if (size == 0)
     {
@@ -190,6 +310,7 @@ bool buflib_context_relocate(struct buflib_context *ctx, void *buf)
     ctx->first_free_handle  += diff;
     ctx->buf_start          += diff;
     ctx->alloc_end          += diff;
+    free_index_stale(ctx);
 
     return true;
 }
@@ -333,6 +454,7 @@ move_block(struct buflib_context* ctx, union buflib_data* block, int shift)
     {
         h_entry->alloc = new_start; /* update handle table */
         memmove(new_block, block, block->val * sizeof(union buflib_data));
+        ctx->stats.bytes_moved += new_block->val * sizeof(union buflib_data);
         retval = true;
     }
 
@@ -352,6 +474,7 @@ buflib_compact(struct buflib_context *ctx)
     union buflib_data *block,
                       *hole = NULL;
     int shift = 0, len;
+    ctx->stats.compactions++;
     /* Store the results of attempting to shrink the handle table */
     bool ret = handle_table_shrink(ctx);
     /* compaction has basically two modes of operation:
@@ -424,6 +547,7 @@ buflib_compact(struct buflib_context *ctx)
      */
     ctx->alloc_end += shift;
     ctx->compact = true;
+    free_index_stale(ctx);
     return ret || shift;
 }
 
@@ -511,6 +635,7 @@ buflib_buffer_shift(struct buflib_context *ctx, int shift)
         (ctx->alloc_end - ctx->buf_start) * sizeof(union buflib_data));
     ctx->buf_start += shift;
     ctx->alloc_end += shift;
+    free_index_stale(ctx);
     shift *= sizeof(union buflib_data);
     union buflib_data *handle;
     for (handle = ctx->last_handle; handle < ctx->handle_table; handle++)
@@ -573,8 +698,9 @@ buflib_alloc_ex(struct buflib_context *ctx, size_t size,
 {
     union buflib_data *handle, *block;
     bool last;
+    unsigned long walked;
     /* This really is assigned a value before use */
-    int block_len;
+    int block_len = 0;
     size = (size + sizeof(union buflib_data) - 1) /
            sizeof(union buflib_data)
            + BUFLIB_NUM_FIELDS;
@@ -611,7 +737,40 @@ buffer_alloc:
     /* need to re-evaluate last before the loop because the last allocation
      * possibly made room in its front to fit this, so last would be wrong */
     last = false;
-    for (block = find_first_free(ctx);; block += block_len)
+#if BUFLIB_FREE_INDEX_SIZE > 0
+    if (free_index_ready(ctx))
+    {
+        int i;
+        ctx->stats.index_hits++;
+        /* Same first-fit as the walk below, only over free blocks */
+        for (i = 0; i < ctx->free_index_len; i++)
+        {
+            block = ctx->free_index[i];
+            block_len = -block->val;
+            if ((size_t)block_len >= size)
+                break;
+        }
+
+        if (i < ctx->free_index_len)
+        {
+            /* the remainder stays in place in the index */
+            if ((size_t)block_len > size)
+                ctx->free_index[i] = block + size;
+            else
+                free_index_remove(ctx, i);
+        }
+        else
+        {
+            block = ctx->alloc_end;
+            last = true;
+            block_len = ctx->last_handle - block;
+            if ((size_t)block_len < size)
+                block = NULL;
+        }
+    }
+    else
+#endif /* BUFLIB_FREE_INDEX_SIZE */
+    for (block = find_first_free(ctx), walked = 0;; block += block_len, walked++)
     {
         /* If the last used block extends all the way to the handle table, the
          * block "after" it doesn't have a header. Because of this, it's easier
@@ -625,6 +784,7 @@ buffer_alloc:
             block_len = ctx->last_handle - block;
             if ((size_t)block_len < size)
                 block = NULL;
+            count_walk(ctx, walked);
             break;
         }
 
@@ -638,7 +798,10 @@ buffer_alloc:
          * handled at compaction.
          */
         if ((size_t)block_len >= size)
+        {
+            count_walk(ctx, walked);
             break;
+        }
     }
     if (!block)
     {
@@ -663,6 +826,7 @@ buffer_alloc:
     block[BUFLIB_IDX_PIN].pincount = 0;
 
     handle->alloc = (char*)&block[BUFLIB_NUM_FIELDS];
+    ctx->stats.allocs++;
 
     BDEBUGF("buflib_alloc_ex: size=%d handle=%p clb=%p\n",
             (unsigned int)size, (void *)handle, (void *)ops);
@@ -706,12 +870,15 @@ find_block_before(struct buflib_context *ctx, union buflib_data* block,
         return NULL;
 
     /* find the block that's before the current one */
+    unsigned long walked = 0;
     while (next_block != block)
     {
         check_block_length(ctx, ret);
         ret = next_block;
         next_block += abs(ret->val);
+        walked++;
     }
+    count_walk(ctx, walked);
 
     /* don't return it if the found block isn't free */
     if (is_free && ret->val >= 0)
@@ -729,9 +896,24 @@ buflib_free(struct buflib_context *ctx, int handle_num)
     union buflib_data *handle = ctx->handle_table - handle_num,
                       *freed_block = handle_to_block(ctx, handle_num),
                       *block, *next_block;
+#if BUFLIB_FREE_INDEX_SIZE > 0
+    bool indexed = free_index_ready(ctx);
+    int at = 0; /* index position of the first free block above */
+#endif
     /* We need to find the block before the current one, to see if it is free
      * and can be merged with this one.
      */
+#if BUFLIB_FREE_INDEX_SIZE > 0
+    if (indexed)
+    {
+        ctx->stats.index_hits++;
+        at = free_index_find(ctx, freed_block);
+        block = at > 0 ? ctx->free_index[at - 1] : NULL;
+        if (block && block - block->val != freed_block)
+            block = NULL;
+    }
+    else
+#endif
     block = find_block_before(ctx, freed_block, true);
     if (block)
     {
@@ -749,16 +931,33 @@ buflib_free(struct buflib_context *ctx, int handle_num)
     next_block = block - block->val;
     /* Check if we are merging with the free space at alloc_end. */
     if (next_block == ctx->alloc_end)
+    {
         ctx->alloc_end = block;
+#if BUFLIB_FREE_INDEX_SIZE > 0
+        if (indexed && block != freed_block)
+            free_index_remove(ctx, at - 1);
+#endif
+    }
     /* Otherwise, the next block might still be a "normal" free block, and the
      * mid-allocation free means that the buffer is no longer compact.
      */
     else {
         ctx->compact = false;
         if (next_block->val < 0)
+        {
             block->val += next_block->val;
+#if BUFLIB_FREE_INDEX_SIZE > 0
+            if (indexed)
+                free_index_remove(ctx, at);
+#endif
+        }
+#if BUFLIB_FREE_INDEX_SIZE > 0
+        if (indexed && block == freed_block)
+            free_index_insert(ctx, at, block);
+#endif
     }
     handle_free(ctx, handle);
+    ctx->stats.frees++;
     handle->alloc = NULL;
 
     return 0; /* unconditionally */
@@ -904,6 +1103,7 @@ buflib_shrink(struct buflib_context* ctx, int handle, void* new_start, size_t ne
     if (new_next_block > old_next_block)
         return false;
 
+    free_index_stale(ctx);
     metadata_size.val = aligned_oldstart - block;
     /* update val and the handle table entry */
     new_block = aligned_newstart - metadata_size.val;
@@ -949,6 +1149,11 @@ buflib_shrink(struct buflib_context* ctx, int handle, void* new_start, size_t ne
     return true;
 }
 
+void buflib_get_stats(struct buflib_context *ctx, struct buflib_stats *stats)
+{
+    *stats = ctx->stats;
+}
+
 void buflib_pin(struct buflib_context *ctx, int handle)
 {
     if ((BUFLIB_PARANOIA & PARANOIA_CHECK_PINNING) && handle <= 0)
@@ -21,6 +21,7 @@
  ****************************************************************************/
 #include "config.h"
 #include <stdio.h>
+#include <ctype.h>
 #include <errno.h>
 #include "string-extra.h"
 #include <stdbool.h>
@@ -38,6 +39,7 @@
 #include "core_alloc.h"
 #include "dir.h"
 #include "storage.h"
+#include "disk.h"
 #include "audio.h"
 #include "rbpaths.h"
 #include "linked_list.h"
@@ -103,6 +105,8 @@ struct sab
     struct filestr_base   stream;    /* scan directory stream */
     struct file_base_info info;      /* scanned entry info */
     bool volatile         quit;      /* halt all scanning */
+    bool                  retained;  /* next directory's entries are kept
+                                        from before a suspend */
     struct sab_component  *stackend; /* end of stack pointer */
     struct sab_component  *top;      /* current top of stack */
     struct sab_component
@@ -261,6 +265,8 @@ static struct dircache_runinfo
         struct file_base_binding *resolved0; /* first resolved binding in list */
         struct file_base_binding *queued0;   /* first queued binding in list */
         struct sab               *sabp;      /* if building, struct sab in use */
+        bool                     revalidate; /* entries kept over a suspend
+                                                must be checked by the build */
     } dcrivol[NUM_VOLUMES];
 } dircache_runinfo;
 
@@ -287,6 +293,8 @@ static struct dircache_runinfo
 
 #define DCRIVOL_i(i)             (&dircache_runinfo.dcrivol[i])
 #define DCRIVOL_infop(infop)     (&dircache_runinfo.dcrivol[BASEINFO_VOL(infop)])
+#define DCRIVOL_dirinfop(dirinfop) \
+    (&dircache_runinfo.dcrivol[BASEINFO_VOL(dirinfop)])
 #define DCRIVOL_bindp(bindp)     (&dircache_runinfo.dcrivol[BASEBINDING_VOL(bindp)])
 #define DCRIVOL(x)               DCRIVOL_##x(x)
 
@@ -938,6 +946,330 @@ static int entry_reassign_name(struct dircache_entry *ce,
     return entry_assign_name(ce, newname, newlen);
 }
 
+/**
+ * get a pointer to the entry's name and its length
+ */
+static const unsigned char * entry_name_ref(const struct dircache_entry *ce,
+                                            size_t *lenp)
+{
+    if (LIKELY(!ce->tinyname))
+    {
+        *lenp = CE_NAMESIZE(ce->namelen);
+        return get_name(ce->name);
+    }
+
+    size_t len = 0;
+    while (len < MAX_TINYNAME && ce->namebuf[len])
+        len++;
+
+    *lenp = len;
+    return ce->namebuf;
+}
+
+#ifdef DIRCACHE_HASH_SLOTS
+/** Directory name hash index **/
+
+/* Large directories get an open-addressed table of the indexes of their
+ * entries keyed by case-folded name. Tables are packed in order into a static
+ * pool; a table is dropped whenever it can't be kept exactly in sync and is
+ * rebuilt on the next lookup. */
+static struct namehash_table
+{
+    int          diridx;    /* indexed directory */
+    dc_serial_t  serialnum; /* serial number of the directory */
+    unsigned int offset;    /* first slot in namehash_slots */
+    unsigned int mask;      /* number of slots - 1 */
+    unsigned int count;     /* number of hashed entries */
+    unsigned int unhashed;  /* entries that can only be found by scanning */
+    unsigned int lastuse;   /* namehash_clock at last lookup */
+} namehash_tables[DIRCACHE_HASH_DIRS];
+
+static int namehash_slots[DIRCACHE_HASH_SLOTS];
+static unsigned int namehash_count;
+static unsigned int namehash_clock;
+
+/**
+ * hash a name the way strcasecmp() compares it (FNV-1a)
+ */
+static uint32_t namehash_name(const unsigned char *name, size_t len)
+{
+    uint32_t hash = 0x811c9dc5;
+
+    while (len--)
+    {
+        hash ^= tolower(*name++);
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+static uint32_t namehash_entry(const struct dircache_entry *ce)
+{
+    size_t len;
+    const unsigned char *name = entry_name_ref(ce, &len);
+    return namehash_name(name, len);
+}
+
+/**
+ * can the entry be found through the hash of its stored name? 8.3 names are
+ * decoded from the OEM codepage before comparison so those with any byte
+ * outside ASCII would compare differently than stored
+ */
+static bool namehash_entry_hashable(const struct dircache_entry *ce)
+{
+#ifdef HAVE_FILESYSTEM_CODEPAGE
+    if (ce->direntries == 1)
+    {
+        size_t len;
+        const unsigned char *name = entry_name_ref(ce, &len);
+        while (len--)
+        {
+            if (*name++ >= 0x80)
+                return false;
+        }
+    }
+#else
+    (void)ce;
+#endif /* HAVE_FILESYSTEM_CODEPAGE */
+    return true;
+}
+
+/**
+ * return the serial number of the directory at 'diridx'
+ */
+static dc_serial_t get_dir_serialnum(int diridx)
+{
+    return diridx < 0 ? get_idx_dcvolp(diridx)->serialnum :
+                        get_entry(diridx)->serialnum;
+}
+
+/**
+ * return the table of the directory at 'diridx', if any
+ */
+static struct namehash_table * namehash_get(int diridx)
+{
+    for (unsigned int i = 0; i < namehash_count; i++)
+    {
+        if (namehash_tables[i].diridx == diridx)
+            return &namehash_tables[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * return the number of pool slots in use
+ */
+static unsigned int namehash_used(void)
+{
+    if (namehash_count == 0)
+        return 0;
+
+    struct namehash_table *t = &namehash_tables[namehash_count - 1];
+    return t->offset + t->mask + 1;
+}
+
+/**
+ * remove a table and close the gap it leaves in the pool
+ */
+static void namehash_drop(struct namehash_table *t)
+{
+    unsigned int size = t->mask + 1;
+    unsigned int end = t->offset + size;
+
+    memmove(&namehash_slots[t->offset], &namehash_slots[end],
+            (namehash_used() - end) * sizeof (int));
+
+    struct namehash_table *last = &namehash_tables[--namehash_count];
+    for (struct namehash_table *p = t + 1; p <= last; p++)
+        p->offset -= size;
+
+    memmove(t, t + 1, (last - t) * sizeof (*t));
+}
+
+static void namehash_drop_dir(int diridx)
+{
+    struct namehash_table *t = namehash_get(diridx);
+    if (t)
+        namehash_drop(t);
+}
+
+static inline void namehash_clear(void)
+{
+    namehash_count = 0;
+}
+
+/**
+ * add an entry to a table that has room for it
+ */
+static void namehash_add(struct namehash_table *t, int idx)
+{
+    struct dircache_entry *ce = get_entry(idx);
+
+    if (!namehash_entry_hashable(ce))
+    {
+        t->unhashed++;
+        return;
+    }
+
+    int *slots = &namehash_slots[t->offset];
+    unsigned int i = namehash_entry(ce) & t->mask;
+
+    while (slots[i])
+        i = (i + 1) & t->mask;
+
+    slots[i] = idx;
+    t->count++;
+}
+
+/**
+ * (re)build the table of the directory at 'diridx' if it's large enough and
+ * the pool can be made to hold it
+ */
+static struct namehash_table * namehash_build(int diridx)
+{
+    namehash_drop_dir(diridx);
+
+    int *downp = get_downidxp(diridx);
+    if (!downp)
+        return NULL;
+
+    unsigned int count = 0;
+    for (int idx = *downp; idx; idx = get_entry(idx)->next)
+        count++;
+
+    if (count < DIRCACHE_HASH_MIN)
+        return NULL;
+
+    /* keep the load at or below 2/3 */
+    unsigned int size = DIRCACHE_HASH_MIN;
+    while (size < count + count / 2)
+        size *= 2;
+
+    if (size > DIRCACHE_HASH_SLOTS)
+        return NULL;
+
+    /* evict the least recently used until this fits */
+    while (namehash_count >= DIRCACHE_HASH_DIRS ||
+           namehash_used() + size > DIRCACHE_HASH_SLOTS)
+    {
+        struct namehash_table *lru = &namehash_tables[0];
+        for (unsigned int i = 1; i < namehash_count; i++)
+        {
+            struct namehash_table *t = &namehash_tables[i];
+            if ((int)(t->lastuse - lru->lastuse) < 0)
+                lru = t;
+        }
+
+        namehash_drop(lru);
+    }
+
+    struct namehash_table *t = &namehash_tables[namehash_count];
+    t->diridx    = diridx;
+    t->serialnum = get_dir_serialnum(diridx);
+    t->offset    = namehash_used();
+    t->mask      = size - 1;
+    t->count     = 0;
+    t->unhashed  = 0;
+    t->lastuse   = ++namehash_clock;
+    namehash_count++;
+
+    memset(&namehash_slots[t->offset], 0, size * sizeof (int));
+
+    for (int idx = *downp; idx; idx = get_entry(idx)->next)
+        namehash_add(t, idx);
+
+    return t;
+}
+
+/**
+ * return the table of the directory at 'diridx' if it's still valid
+ */
+static struct namehash_table * namehash_valid(int diridx)
+{
+    struct namehash_table *t = namehash_get(diridx);
+    if (t && t->serialnum != get_dir_serialnum(diridx))
+    {
+        namehash_drop(t);
+        t = NULL;
+    }
+
+    return t;
+}
+
+/**
+ * an entry has been linked into the directory at 'diridx'
+ */
+static void namehash_insert(int diridx, int idx)
+{
+    struct namehash_table *t = namehash_valid(diridx);
+    if (!t)
+        return;
+
+    if (3*(t->count + 1) > 2*(t->mask + 1))
+        namehash_build(diridx); /* grow it */
+    else
+        namehash_add(t, idx);
+}
+
+/**
+ * an entry is about to be unlinked from the directory at 'diridx'
+ */
+static void namehash_remove(int diridx, int idx)
+{
+    struct namehash_table *t = namehash_valid(diridx);
+    if (!t)
+        return;
+
+    struct dircache_entry *ce = get_entry(idx);
+
+    if (!namehash_entry_hashable(ce))
+    {
+        t->unhashed--;
+        return;
+    }
+
+    int *slots = &namehash_slots[t->offset];
+    unsigned int mask = t->mask;
+    unsigned int i = namehash_entry(ce) & mask;
+
+    while (slots[i] != idx)
+    {
+        if (!slots[i])
+            return; /* wasn't there */
+
+        i = (i + 1) & mask;
+    }
+
+    /* shift later members of the probe run back into the hole so that no
+       lookup stops short of them */
+    for (unsigned int j = i;;)
+    {
+        j = (j + 1) & mask;
+        if (!slots[j])
+            break;
+
+        unsigned int home = namehash_entry(get_entry(slots[j])) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask))
+        {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+
+    slots[i] = 0;
+    t->count--;
+}
+
+#else /* !DIRCACHE_HASH_SLOTS */
+#define namehash_clear()             do {} while (0)
+#define namehash_drop_dir(diridx)    do {} while (0)
+#define namehash_build(diridx)       do {} while (0)
+#define namehash_insert(diridx, idx) do {} while (0)
+#define namehash_remove(diridx, idx) do {} while (0)
+#endif /* DIRCACHE_HASH_SLOTS */
+
 /**
  * allocate a dircache_entry from memory using freed ones if available
  */
@@ -1007,6 +1339,9 @@ static void free_orphan_entry(struct dircache_runinfo_volume *dcrivolp,
         }
     }
 
+    if (ce->attr & ATTR_DIRECTORY)
+        namehash_drop_dir(idx);
+
     entry_unassign_name(ce);
 
     /* no serialnum says "it's free" (for cache-wide iterators) */
@@ -1098,6 +1433,7 @@ static void free_file_entry(struct file_base_info *infop)
         free_subentries(dcrivolp, &ce->down);
     }
 
+    namehash_remove(ce->up, idx);
     remove_entry(dcrivolp, ce, get_previdxp(idx));
     free_orphan_entry(dcrivolp, ce, idx);
 }
@@ -1153,6 +1489,7 @@ static struct dircache_entry * remove_file_entry(struct file_base_info *infop)
 {
     struct dircache_runinfo_volume *dcrivolp = DCRIVOL(infop);
     struct dircache_entry *ce = get_entry(infop->dcfile.idx);
+    namehash_remove(ce->up, infop->dcfile.idx);
     remove_entry(dcrivolp, ce, get_previdxp(infop->dcfile.idx));
     return ce;
 }
@@ -1226,6 +1563,115 @@ static void process_events(void)
 }
 
 #if defined (DIRCACHE_NATIVE)
+/**
+ * resolve queued user bindings to the scanned entry
+ */
+static void sab_bind_entry(struct file_base_info *infop, int idx,
+                           const struct dircache_entry *ce, long dircluster)
+{
+    infop->fatfile.firstcluster = ce->firstcluster;
+    infop->fatfile.dircluster   = dircluster;
+    infop->fatfile.e.entry      = ce->direntry;
+    infop->fatfile.e.entries    = ce->direntries;
+    infop->dcfile.idx           = idx;
+    infop->dcfile.serialnum     = ce->serialnum;
+    binding_resolve(infop);
+}
+
+/**
+ * is the entry kept over a suspend the same one that was just read? if so,
+ * bring its information up to date
+ */
+static bool sab_refresh_entry(struct dircache_entry *ce,
+                              const struct file_base_info *infop,
+                              const struct fat_direntry *fatentp)
+{
+    size_t len;
+    const unsigned char *name = entry_name_ref(ce, &len);
+
+    if (ce->direntry != infop->fatfile.e.entry ||
+        ce->direntries != infop->fatfile.e.entries ||
+        ce->firstcluster != fatentp->firstcluster ||
+        ((ce->attr ^ fatentp->attr) & ATTR_DIRECTORY) ||
+        strlen(fatentp->name) != len || memcmp(fatentp->name, name, len))
+        return false;
+
+    if (!(fatentp->attr & ATTR_DIRECTORY))
+        ce->filesize = fatentp->filesize;
+
+    ce->attr    = fatentp->attr;
+    ce->wrtdate = fatentp->wrtdate;
+    ce->wrttime = fatentp->wrttime;
+    return true;
+}
+
+/**
+ * free the entries kept over a suspend that lie ahead of the scan but weren't
+ * found on disk; if 'infop' is NULL, the scan is at the end of the directory
+ * and all that are left go
+ */
+static void sab_drop_stale(struct dircache_runinfo_volume *dcrivolp,
+                           int *prevp, const struct file_base_info *infop,
+                           const struct fat_direntry *fatentp)
+{
+    while (1)
+    {
+        int idx = *prevp;
+        struct dircache_entry *ce = get_entry(idx);
+        if (!ce)
+            break;
+
+        if (infop)
+        {
+            if (ce->direntry > infop->fatfile.e.entry)
+                break;
+
+            if (ce->direntry == infop->fatfile.e.entry &&
+                sab_refresh_entry(ce, infop, fatentp))
+                break;
+        }
+
+        if ((ce->attr & ATTR_DIRECTORY) && ce->down)
+            free_subentries(dcrivolp, &ce->down);
+
+        namehash_remove(ce->up, idx);
+        remove_entry(dcrivolp, ce, prevp);
+        free_orphan_entry(dcrivolp, ce, idx);
+    }
+}
+
+/**
+ * may the contents kept over a suspend for the directory about to be scanned
+ * be used as they are? if so, resolve queued user bindings to them as the scan
+ * would have done
+ */
+static bool sab_dir_unchanged(struct sab *sabp, const int *downp,
+                              long dircluster)
+{
+#ifdef HAVE_DISK_JOURNAL
+    struct file_base_info *const infop = &sabp->info;
+
+    if (fat_dir_written(&infop->fatfile) != 0)
+        return false;
+
+    if (DCRIVOL(infop)->queued0)
+    {
+        for (int idx = *downp; idx > 0;)
+        {
+            struct dircache_entry *ce = get_entry(idx);
+            sab_bind_entry(infop, idx, ce, dircluster);
+            idx = ce->next;
+        }
+    }
+
+    return true;
+#else
+    /* no record of what was written; everything must be read again */
+    (void)sabp; (void)downp; (void)dircluster;
+    return false;
+#endif /* HAVE_DISK_JOURNAL */
+}
+
 /**
  * scan and build the contents of a subdirectory
  */
@@ -1234,6 +1680,7 @@ static void sab_process_sub(struct sab *sabp)
     struct fat_direntry *const fatentp = get_dir_fatent();
     struct filestr_base *const streamp = &sabp->stream;
     struct file_base_info *const infop = &sabp->info;
+    struct dircache_runinfo_volume *const dcrivolp = DCRIVOL(infop);
 
     int idx = infop->dcfile.idx;
     int *downp = get_downidxp(idx);
@@ -1247,14 +1694,17 @@ static void sab_process_sub(struct sab *sabp)
         compp->downp = downp;
         compp->prevp = downp;
 
+        const long dircluster = infop->fatfile.firstcluster;
+
+        if (sabp->retained && sab_dir_unchanged(sabp, downp, dircluster))
+            goto dir_settled; /* nothing on disk touched it */
+
         /* open directory stream */
         filestr_base_init(streamp);
         fileobj_fileop_open(streamp, infop, FO_DIRECTORY);
         fat_rewind(&streamp->fatstr);
         uncached_rewinddir_internal(infop);
 
-        const long dircluster = streamp->infop->fatfile.firstcluster;
-
         /* first pass: read directory */
         while (1)
         {
@@ -1276,11 +1726,20 @@ static void sab_process_sub(struct sab *sabp)
                 if (rc < 0)
                     sabp->quit = true;
                 else
+                {
+                    /* anything kept that wasn't found is gone */
+                    if (dcrivolp->revalidate)
+                        sab_drop_stale(dcrivolp, compp->prevp, NULL, NULL);
+
                     compp->prevp = downp; /* rewind list */
+                }
 
                 break;
             }
 
+            if (dcrivolp->revalidate)
+                sab_drop_stale(dcrivolp, compp->prevp, infop, fatentp);
+
             struct dircache_entry *ce;
             int prev = *compp->prevp;
 
@@ -1295,6 +1754,12 @@ static void sab_process_sub(struct sab *sabp)
                 if (ce->direntry == infop->fatfile.e.entry)
                 {
                     compp->prevp = &ce->next;
+
+                    /* entries kept over a suspend had their bindings
+                       dissolved */
+                    if (dcrivolp->revalidate)
+                        sab_bind_entry(infop, prev, ce, dircluster);
+
                     continue; /* already there */
                 }
             }
@@ -1345,7 +1810,9 @@ static void sab_process_sub(struct sab *sabp)
         if (sabp->quit)
             return;
 
+    dir_settled:
         establish_frontier(compp->idx, FRONTIER_SETTLED);
+        namehash_build(compp->idx);
 
         /* second pass: "recurse!" */
         struct dircache_entry *ce = NULL;
@@ -1370,6 +1837,11 @@ static void sab_process_sub(struct sab *sabp)
             }
         }
 
+        /* a directory that was complete before a suspend is marked to be
+           checked before reading it again */
+        sabp->retained = dcrivolp->revalidate &&
+                         ce->frontier == (FRONTIER_NEW | FRONTIER_ZONED);
+
         /* even if it got zoned from outside it is about to be scanned in
            its entirety and may be considered new again */
         ce->frontier = FRONTIER_NEW;
@@ -1389,7 +1861,7 @@ static void sab_process_sub(struct sab *sabp)
 /**
  * scan and build the contents of a directory or volume root
  */
-static void sab_process_dir(struct file_base_info *infop, bool issab)
+static bool sab_process_dir(struct file_base_info *infop, bool issab)
 {
     /* infop should have been fully opened meaning that all its parent
        directory information is filled in and intact; the binding information
@@ -1404,6 +1876,9 @@ static void sab_process_dir(struct file_base_info *infop, bool issab)
     struct sab *sabp = &dirsab.sab;
 
     sabp->quit     = false;
+    sabp->retained = DCRIVOL(infop)->revalidate &&
+                     get_frontier(infop->dcfile.idx) ==
+                        (FRONTIER_NEW | FRONTIER_ZONED);
     sabp->stackend = &sabp->stack[ARRAYLEN(dirsab.stack)];
     sabp->top      = sabp->stackend;
     sabp->info     = *infop;
@@ -1416,12 +1891,15 @@ static void sab_process_dir(struct file_base_info *infop, bool issab)
 
     if (issab)
         DCRIVOL(infop)->sabp = NULL;
+
+    return !sabp->quit;
 }
 
 /**
- * scan and build the entire tree for a volume
+ * scan and build the entire tree for a volume; returns whether or not it
+ * went through all of it
  */
-static void sab_process_volume(struct dircache_volume *dcvolp)
+static bool sab_process_volume(struct dircache_volume *dcvolp)
 {
     int rc;
 
@@ -1438,13 +1916,13 @@ static void sab_process_volume(struct dircache_volume *dcvolp)
         /* probably not mounted */
         logf("SAB - no root %d: %d", volume, rc);
         establish_frontier(idx, FRONTIER_NEW);
-        return;
+        return false;
     }
 
     info.dcfile.idx       = idx;
     info.dcfile.serialnum = dcvolp->serialnum;
     binding_resolve(&info);
-    sab_process_dir(&info, true);
+    return sab_process_dir(&info, true);
 }
 
 /**
@@ -1548,6 +2026,33 @@ void dircache_rewinddir_dirent(struct dirscan_info *scanp)
     dircache_dcfile_init(&scanp->dcscan);
 }
 
+/**
+ * fill in the FS and binding information of an entry for internal scanning
+ */
+static int entry_get_fatent(const struct dircache_entry *ce, int idx,
+                            struct file_base_info *infop,
+                            struct fat_direntry *fatent)
+{
+    /* FS entry information that we maintain */
+    entry_name_copy(fatent->name, ce);
+    fatent->shortname[0]     = '\0';
+    fatent->attr             = ce->attr;
+    /* file code file scanning does not need time information */
+    fatent->filesize         = (ce->attr & ATTR_DIRECTORY) ? 0 : ce->filesize;
+    fatent->firstcluster     = ce->firstcluster;
+
+    /* FS entry directory information */
+    infop->fatfile.e.entry   = ce->direntry;
+    infop->fatfile.e.entries = ce->direntries;
+
+    /* dircache file binding information */
+    infop->dcfile.idx        = idx;
+    infop->dcfile.serialnum  = ce->serialnum;
+
+    /* return whether this needs decoding */
+    return ce->direntries == 1 ? 2 : 1;
+}
+
 /**
  * this function is the back end to file API internal scanning, which requires
  * much more detail about the directory entries; this is allowed to make
@@ -1580,6 +2085,16 @@ int dircache_readdir_internal(struct filestr_base *stream,
     unsigned int frontier = diridx < 0 ?
         dcvolp->frontier : get_entry(diridx)->frontier;
 
+    if (frontier != FRONTIER_SETTLED && DCRIVOL(dirinfop)->revalidate)
+    {
+        /* entries kept over a suspend may be stale until the build has been
+           through this directory; don't hand them out */
+        if (stream->flags & FF_CACHEONLY)
+            goto read_eod;
+
+        return uncached_readdir_internal(stream, infop, fatent);
+    }
+
     int idx = infop->dcfile.idx;
     if (idx == 0) /* rewound? */
         idx = diridx <= 0 ? dcvolp->root_down : get_entry(diridx)->down;
@@ -1606,24 +2121,7 @@ int dircache_readdir_internal(struct filestr_base *stream,
         goto read_eod;
     }
 
-    /* FS entry information that we maintain */
-    entry_name_copy(fatent->name, ce);
-    fatent->shortname[0]     = '\0';
-    fatent->attr             = ce->attr;
-    /* file code file scanning does not need time information */
-    fatent->filesize         = (ce->attr & ATTR_DIRECTORY) ? 0 : ce->filesize;
-    fatent->firstcluster     = ce->firstcluster;
-
-    /* FS entry directory information */
-    infop->fatfile.e.entry   = ce->direntry;
-    infop->fatfile.e.entries = ce->direntries;
-
-    /* dircache file binding information */
-    infop->dcfile.idx        = idx;
-    infop->dcfile.serialnum  = ce->serialnum;
-
-    /* return whether this needs decoding */
-    int rc = ce->direntries == 1 ? 2 : 1;
+    int rc = entry_get_fatent(ce, idx, infop, fatent);
 
     if (frontier == FRONTIER_SETTLED)
     {
@@ -1652,6 +2150,62 @@ void dircache_rewinddir_internal(struct file_base_info *infop)
     dircache_dcfile_init(&infop->dcfile);
 }
 
+#ifdef DIRCACHE_HASH_SLOTS
+/**
+ * look up a name in a completely cached directory through its name hash,
+ * indexing the directory first if it's large enough; the result is as if
+ * dircache_readdir_internal() had been called until the name matched
+ *
+ * returns: > 0 if found (2 if the name still needs decoding)
+ *          0 if not in the directory
+ *          < 0 if the directory must be scanned instead
+ */
+int dircache_find_internal(struct filestr_base *stream, const char *name,
+                           struct file_base_info *infop,
+                           struct fat_direntry *fatent)
+{
+    /* call with writer exclusion */
+    struct file_base_info *dirinfop = stream->infop;
+
+    if (!dirinfop->dcfile.serialnum)
+        return -1;
+
+    int diridx = dirinfop->dcfile.idx;
+    if (get_frontier(diridx) != FRONTIER_SETTLED)
+        return -1;
+
+    struct namehash_table *t = namehash_valid(diridx);
+    if (!t && !(t = namehash_build(diridx)))
+        return -1;
+
+    t->lastuse = ++namehash_clock;
+
+    size_t len = strlen(name);
+    int *slots = &namehash_slots[t->offset];
+    unsigned int i = namehash_name(name, len) & t->mask;
+    int idx;
+
+    while ((idx = slots[i]))
+    {
+        const struct dircache_entry *ce = get_entry(idx);
+        size_t celen;
+        const unsigned char *cename = entry_name_ref(ce, &celen);
+
+        if (celen == len && !strncasecmp(cename, name, len))
+            return entry_get_fatent(ce, idx, infop, fatent);
+
+        i = (i + 1) & t->mask;
+    }
+
+    if (t->unhashed)
+        return -1;
+
+    fat_empty_fat_direntry(fatent);
+    infop->fatfile.e.entries = 0;
+    return 0;
+}
+#endif /* DIRCACHE_HASH_SLOTS */
+
 #else /* !DIRCACHE_NATIVE (for all others) */
 
 #####################
@@ -1763,6 +2317,22 @@ int dircache_readdir_r(struct dircache_dirscan *dir, struct DIRENT *result)
 
 #endif /* DIRCACHE_* */
 
+/**
+ * stop recording disk writes once no volume has kept entries left to check
+ */
+static void revalidate_finish(void)
+{
+#ifdef HAVE_DISK_JOURNAL
+    for (int i = 0; i < NUM_VOLUMES; i++)
+    {
+        if (DCRIVOL(i)->revalidate)
+            return;
+    }
+
+    disk_journal_close();
+#endif /* HAVE_DISK_JOURNAL */
+}
+
 /**
  * reset the cache for the specified volume
  */
@@ -1791,12 +2361,15 @@ static void reset_volume(IF_MV_NONVOID(int volume))
     #endif
             binding_dissolve_volume(dcrivolp);
 
+        namehash_drop_dir(-i - 1);
+
         /* set it back to unscanned */
         dcvolp->status      = DIRCACHE_IDLE;
         dcvolp->frontier    = FRONTIER_NEW;
         dcvolp->root_down   = 0;
         dcvolp->build_ticks = 0;
         dcvolp->serialnum   = 0;
+        dcrivolp->revalidate = false;
     }
 }
 
@@ -1810,6 +2383,8 @@ static void reset_cache(void)
 
     /* blast all the volumes */
     reset_volume(IF_MV(-1));
+    namehash_clear();
+    revalidate_finish();
 
 #ifdef DIRCACHE_DUMPSTER
     dumpster_clean_buffer(dircache_runinfo.p + ENTRYSIZE,
@@ -1831,6 +2406,116 @@ static void reset_cache(void)
     /* dircache.last_size stays */
 }
 
+/* frontier codes of directories kept over a suspend: those that were complete
+ * become candidates for keeping their contents (FRONTIER_NEW | FRONTIER_ZONED)
+ * and all others are read again; candidates not yet checked since an earlier
+ * suspend remain candidates */
+static const uint8_t revalidate_codes[2][4] =
+{
+    [false] =
+    {
+        [FRONTIER_SETTLED]                 = FRONTIER_NEW | FRONTIER_ZONED,
+        [FRONTIER_NEW]                     = FRONTIER_NEW,
+        [FRONTIER_ZONED]                   = FRONTIER_NEW,
+        [FRONTIER_NEW | FRONTIER_ZONED]    = FRONTIER_NEW,
+    },
+    [true] =
+    {
+        [FRONTIER_SETTLED]                 = FRONTIER_NEW | FRONTIER_ZONED,
+        [FRONTIER_NEW]                     = FRONTIER_NEW,
+        [FRONTIER_ZONED]                   = FRONTIER_NEW,
+        [FRONTIER_NEW | FRONTIER_ZONED]    = FRONTIER_NEW | FRONTIER_ZONED,
+    },
+};
+
+#ifdef HAVE_EEPROM_SETTINGS
+/* frontier codes to undo revalidate_codes[false] when the disk is known to be
+   unchanged since */
+static const uint8_t restore_codes[4] =
+{
+    [FRONTIER_SETTLED]                     = FRONTIER_SETTLED,
+    [FRONTIER_NEW]                         = FRONTIER_NEW,
+    [FRONTIER_ZONED]                       = FRONTIER_ZONED,
+    [FRONTIER_NEW | FRONTIER_ZONED]        = FRONTIER_SETTLED,
+};
+#endif /* HAVE_EEPROM_SETTINGS */
+
+/**
+ * recode the frontiers of a volume's directories through the table 'codes'
+ */
+static void recode_frontiers(int volume, const uint8_t codes[4])
+{
+    struct dircache_volume *dcvolp = DCVOL(volume);
+    dcvolp->frontier = codes[dcvolp->frontier];
+
+    /* walk the tree without recursion */
+    int idx = dcvolp->root_down;
+    while (idx > 0)
+    {
+        struct dircache_entry *ce = get_entry(idx);
+
+        if ((ce->attr & ATTR_DIRECTORY) &&
+            !(ce->tinyname && is_dotdir_name((const char *)ce->namebuf)))
+        {
+            ce->frontier = codes[ce->frontier];
+
+            if (ce->down)
+            {
+                idx = ce->down;
+                continue;
+            }
+        }
+
+        while (!ce->next && ce->up > 0)
+            ce = get_entry(ce->up);
+
+        idx = ce->next;
+    }
+}
+
+/**
+ * keep the cache over a suspend; volumes that were completely built, or still
+ * being checked after the last one, are kept for the next build to check
+ * instead of scanning them all over again
+ */
+static void retain_cache(void)
+{
+    if (!dircache_runinfo.handle)
+        return; /* no buffer => nothing cached */
+
+    for (int i = 0; i < NUM_VOLUMES; i++)
+    {
+        struct dircache_volume *dcvolp = DCVOL(i);
+        struct dircache_runinfo_volume *dcrivolp = DCRIVOL(i);
+
+        if (dcvolp->status != DIRCACHE_READY && !dcrivolp->revalidate)
+        {
+        #ifdef HAVE_MULTIVOLUME
+            reset_volume(i);
+            continue;
+        #else
+            reset_cache();
+            return;
+        #endif
+        }
+
+        /* stop any scan and build on this one */
+        if (dcrivolp->sabp)
+            dcrivolp->sabp->quit = true;
+
+        binding_dissolve_volume(dcrivolp);
+        recode_frontiers(i, revalidate_codes[dcrivolp->revalidate]);
+        dcrivolp->revalidate = true;
+    }
+
+    /* the tables are rebuilt as directories settle again */
+    namehash_clear();
+
+#ifdef HAVE_DISK_JOURNAL
+    disk_journal_open();
+#endif
+}
+
 /**
  * checks each "idle" volume and builds it
  */
@@ -1840,15 +2525,28 @@ static void build_volumes(void)
 
     for (int i = 0; i < NUM_VOLUMES; i++)
     {
+        struct dircache_volume *dcvolp = DCVOL(i);
+        struct dircache_runinfo_volume *dcrivolp = DCRIVOL(i);
+
         /* this does reader locking but we already own that */
         if (!volume_ismounted(IF_MV(i)))
-            continue;
+        {
+            /* what was kept can't be checked if it didn't come back */
+            if (dcrivolp->revalidate)
+            {
+            #ifdef HAVE_MULTIVOLUME
+                reset_volume(i);
+            #else
+                reset_cache();
+            #endif
+            }
 
-        struct dircache_volume *dcvolp = DCVOL(i);
+            continue;
+        }
 
         /* can't already be "scanning" because that's us; doesn't retry
-           "ready" volumes */
-        if (dcvolp->status == DIRCACHE_READY)
+           "ready" volumes unless their entries were kept over a suspend */
+        if (dcvolp->status == DIRCACHE_READY && !dcrivolp->revalidate)
             continue;
 
         /* measure how long it takes to build the cache for each volume */
@@ -1858,16 +2556,37 @@ static void build_volumes(void)
         dcvolp->status = DIRCACHE_SCANNING;
         dcvolp->start_tick = current_tick;
 
-        sab_process_volume(dcvolp);
+        bool done = sab_process_volume(dcvolp);
 
         if (dircache_runinfo.suspended)
             break;
 
+        if (dcrivolp->revalidate)
+        {
+            if (!done)
+            {
+                /* some kept entries could not be checked; don't trust any
+                   and build it again from scratch */
+            #ifdef HAVE_MULTIVOLUME
+                reset_volume(i);
+            #else
+                reset_cache();
+            #endif
+                i--;
+                continue;
+            }
+
+            dcrivolp->revalidate = false;
+        }
+
         /* whatever happened, it's ready unless reset */
         dcvolp->build_ticks = current_tick - dcvolp->start_tick;
         dcvolp->status = DIRCACHE_READY;
     }
 
+    if (!dircache_runinfo.suspended)
+        revalidate_finish();
+
     size_t reserve_used = reserve_buf_used();
     if (reserve_used > dircache.reserve_used)
         dircache.reserve_used = reserve_used;
@@ -2129,7 +2848,11 @@ static void dircache_suspend_internal(bool freeit)
 
     unsigned int thread_id = dircache_runinfo.thread_id;
 
-    reset_cache();
+    if (freeit)
+        reset_cache();
+    else
+        retain_cache();
+
     clear_dircache_queue();
 
     /* grab the buffer away into our control; the cache won't need it now */
@@ -2273,7 +2996,7 @@ void dircache_get_rootinfo(struct file_base_info *infop)
     int volume = BASEINFO_VOL(infop);
     struct dircache_volume *dcvolp = DCVOL(volume);
 
-    if (dcvolp->serialnum)
+    if (dcvolp->serialnum && !dircache_runinfo.suspended)
     {
         /* root has a binding */
         infop->dcfile.idx       = -volume - 1;
@@ -2351,6 +3074,7 @@ void dircache_fileop_create(struct file_base_info *dirinfop,
         ce->filesize = dinp->size;
 
     insert_file_entry(dirinfop, ce);
+    namehash_insert(dirinfop->dcfile.idx, idx);
 
     /* file binding will have been queued when it was opened; just resolve */
     infop->dcfile.idx       = idx;
@@ -2433,10 +3157,12 @@ void dircache_fileop_rename(struct file_base_info *dirinfop,
         dc_serial_t serialnum = next_serialnum();
         ce->serialnum = serialnum;
         bindp->info.dcfile.serialnum = serialnum;
+        namehash_insert(dirinfop->dcfile.idx, bindp->info.dcfile.idx);
     }
     else
     {
         /* it cannot be kept around without a valid name */
+        namehash_drop_dir(dirinfop->dcfile.idx);
         free_file_entry(&bindp->info);
         establish_frontier(dirinfop->dcfile.idx, FRONTIER_ZONED);
     }
@@ -2529,6 +3255,24 @@ static ssize_t get_path_sub(int idx, struct get_path_sub_data *data)
                              data->size > (size_t)len ? data->size - len : 0);
 }
 
+/**
+ * is the entry one kept over a suspend that the build hasn't checked yet?
+ */
+static bool entry_unverified(int idx)
+{
+    if (dircache_runinfo.suspended)
+        return true;
+
+    int diridx = get_entry(idx)->up;
+    if (get_frontier(diridx) == FRONTIER_SETTLED)
+        return false;
+
+    while (diridx > 0)
+        diridx = get_entry(diridx)->up;
+
+    return DCRIVOL_i(IF_MV_VOL(-diridx - 1))->revalidate;
+}
+
 /**
  * validate the file's entry/binding serial number
  * the dircache file's serial number must match the indexed entry's or the
@@ -2564,6 +3308,9 @@ static int check_file_serialnum(const struct dircache_file *dcfilep)
     if (serialnum != s)
         return -EBADF;
 
+    if (idx > 0 && entry_unverified(idx))
+        return -EBADF;
+
     return 0;
 }
 
@@ -3139,6 +3886,18 @@ int INIT_ATTR dircache_load(void)
 
     dircache.reserve_used = 0;
 
+    /* the snapshot was taken while suspended, with the directories marked for
+       checking; what was complete then is complete now */
+    for (int i = 0; i < NUM_VOLUMES; i++)
+    {
+        if (dircache.dcvol[i].status == DIRCACHE_READY)
+            recode_frontiers(i, restore_codes);
+    #ifdef HAVE_MULTIVOLUME
+        else
+            reset_volume(i);
+    #endif
+    }
+
     /* enable the cache but do not try to build it */
     dircache_enable_internal(false);
 
@@ -534,6 +534,145 @@ bool disk_present(IF_MD_NONVOID(int drive))
     return rc == 0;
 }
 
+#ifdef HAVE_DISK_JOURNAL
+/* number of written sector ranges remembered per drive; once exceeded, the
+   two closest ranges are merged so that the record remains a superset of
+   what was actually written; the disk cache lock guards it since the FAT
+   driver records its write-backs while holding that */
+#define DISK_JOURNAL_RANGES 32
+
+static struct disk_journal
+{
+    bool open;                    /* recording writes */
+    struct disk_journal_drive
+    {
+        unsigned int count;       /* number of ranges in use */
+        struct
+        {
+            sector_t first;       /* first sector written */
+            sector_t last;        /* last sector written */
+        } range[DISK_JOURNAL_RANGES + 1]; /* sorted; don't touch */
+    } drive[NUM_DRIVES];
+} disk_journal;
+
+void disk_journal_open(void)
+{
+    dc_lock_cache();
+
+    /* reopening keeps what's recorded so far */
+    if (!disk_journal.open)
+    {
+        for (int i = 0; i < NUM_DRIVES; i++)
+            disk_journal.drive[i].count = 0;
+
+        disk_journal.open = true;
+    }
+
+    dc_unlock_cache();
+}
+
+void disk_journal_close(void)
+{
+    dc_lock_cache();
+    disk_journal.open = false;
+    dc_unlock_cache();
+}
+
+void disk_journal_write(IF_MD(int drive,) sector_t start, unsigned long count)
+{
+    if (!CHECK_DRV(drive) || count == 0)
+        return;
+
+    dc_lock_cache();
+
+    if (disk_journal.open)
+    {
+        struct disk_journal_drive *jd = &disk_journal.drive[IF_MD_DRV(drive)];
+        sector_t first = start;
+        sector_t last  = start + count - 1;
+
+        /* skip the ranges below that don't touch this one */
+        unsigned int i = 0;
+        while (i < jd->count && jd->range[i].last + 1 < first)
+            i++;
+
+        /* absorb the ones it overlaps or adjoins */
+        unsigned int j = i;
+        while (j < jd->count && jd->range[j].first <= last + 1)
+        {
+            first = MIN(first, jd->range[j].first);
+            last  = MAX(last, jd->range[j].last);
+            j++;
+        }
+
+        memmove(&jd->range[i + 1], &jd->range[j],
+                (jd->count - j) * sizeof (jd->range[0]));
+        jd->count += 1 - (j - i);
+        jd->range[i].first = first;
+        jd->range[i].last  = last;
+
+        if (jd->count > DISK_JOURNAL_RANGES)
+        {
+            /* out of room; merge across the smallest gap */
+            unsigned int k = 0;
+            for (i = 1; i < jd->count - 1; i++)
+            {
+                if (jd->range[i + 1].first - jd->range[i].last <
+                    jd->range[k + 1].first - jd->range[k].last)
+                    k = i;
+            }
+
+            jd->range[k].last = jd->range[k + 1].last;
+            memmove(&jd->range[k + 1], &jd->range[k + 2],
+                    (jd->count - k - 2) * sizeof (jd->range[0]));
+            jd->count--;
+        }
+    }
+
+    dc_unlock_cache();
+}
+
+int disk_journal_written(IF_MD(int drive,) sector_t start,
+                         unsigned long count)
+{
+    if (!CHECK_DRV(drive))
+        return -1;
+
+#ifdef HAVE_HOTSWAP
+    /* the media could have been swapped behind our back */
+    if (storage_removable(IF_MD_DRV(drive)))
+        return -1;
+#endif
+
+    int rc = -1;
+
+    dc_lock_cache();
+
+    if (disk_journal.open)
+    {
+        const struct disk_journal_drive *jd =
+            &disk_journal.drive[IF_MD_DRV(drive)];
+        sector_t last = start + count - 1;
+
+        rc = 0;
+        for (unsigned int i = 0; i < jd->count; i++)
+        {
+            if (jd->range[i].first > last)
+                break;
+
+            if (jd->range[i].last >= start)
+            {
+                rc = 1;
+                break;
+            }
+        }
+    }
+
+    dc_unlock_cache();
+    return rc;
+}
+#endif /* HAVE_DISK_JOURNAL */
+
 
 /** Volume-centric functions **/
 
@@ -454,13 +454,20 @@ static NO_INLINE int open_path_component(struct pathwalk *walkp,
     fat_filestr_init(&stream->fatstr, &parentp->info.fatfile);
     rewinddir_internal(&compp->info);
 
-    while ((rc = readdir_internal(stream, &compp->info, &dir_fatent)) > 0)
+#ifdef DIRCACHE_HASH_SLOTS
+    /* large cached directories may be searched by name directly */
+    rc = dircache_find_internal(stream, compname, &compp->info, &dir_fatent);
+    if (rc < 0)
+#endif /* DIRCACHE_HASH_SLOTS */
     {
-        if (rc > 1 && !(callflags & FF_NOISO))
-            iso_decode_d_name(dir_fatent.name);
+        while ((rc = readdir_internal(stream, &compp->info, &dir_fatent)) > 0)
+        {
+            if (rc > 1 && !(callflags & FF_NOISO))
+                iso_decode_d_name(dir_fatent.name);
 
-        if (!strcasecmp(compname, dir_fatent.name))
-            break;
+            if (!strcasecmp(compname, dir_fatent.name))
+                break;
+        }
     }
 
     if (rc == 0)
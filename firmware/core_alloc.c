@@ -85,6 +85,11 @@ size_t core_allocatable(void)
     return buflib_allocatable(&core_ctx);
 }
 
+void core_get_stats(struct buflib_stats *stats)
+{
+    buflib_get_stats(&core_ctx, stats);
+}
+
 int core_free(int handle)
 {
     return buflib_free(&core_ctx, handle);
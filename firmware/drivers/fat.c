@@ -247,6 +247,12 @@ static struct bpb
     unsigned long fatrgnstart;
     unsigned long fatrgnend;
     struct fsinfo fsinfo;
+#if FAT_FREE_SUMMARY_GROUPS > 0
+    /* free cluster count of each group of FAT32 sectors or
+       FREESUM_UNKNOWN if the group hasn't been counted yet */
+    unsigned long freesum_secs;     /* FAT sectors per group */
+    uint32_t freesum[FAT_FREE_SUMMARY_GROUPS];
+#endif
 #ifdef HAVE_FAT16SUPPORT
     unsigned int bpb_rootentcnt;    /* Number of dir entries in the root */
     /* internals for FAT16 support */
@@ -295,6 +301,12 @@ static uint8_t fat_bounce_buffers[NUM_VOLUMES][BOUNCE_SECTOR_SIZE*FAT_BOUNCE_SEC
     (fat_bounce_buffers[IF_MV_VOL((bpb)->volume)])
 #endif
 
+#if FAT_FREE_SUMMARY_GROUPS > 0
+#define FREESUM_UNKNOWN 0xffffffff
+#define FREESUM_GROUP(bpb, fatsec) \
+    ((bpb)->freesum[(fatsec) / (bpb)->freesum_secs])
+#endif
+
 #define IS_FAT_SECTOR(bpb, sector) \
     (!((sector) >= (bpb)->fatrgnend || (sector) < (bpb)->fatrgnstart))
 
@@ -315,6 +327,20 @@ static uint8_t fat_bounce_buffers[NUM_VOLUMES][BOUNCE_SECTOR_SIZE*FAT_BOUNCE_SEC
         }                                            \
         _bpb; })
 
+#if FAT_EXTENT_CACHE_SIZE > 0
+/* bumped whenever a link in a cluster chain is changed or freed so that any
+   extents recorded from the old chain are discarded */
+static unsigned int fat_chain_gen;
+static struct fat_extent_stats fat_extent_stats;
+
+static inline void fat_chain_changed(void)
+{
+    fat_chain_gen++;
+}
+#else
+#define fat_chain_changed() do {} while (0)
+#endif /* FAT_EXTENT_CACHE_SIZE */
+
 enum add_dir_entry_flags
 {
     DIRENT_RETURN      = 0x01, /* return the new short entry */
@@ -400,6 +426,10 @@ void dc_writeback_callback(IF_MV(int volume,) sector_t sector, void *buf)
                    " (error %d)\n", __func__, (uint64_t)sector, rc);
         }
 
+    #ifdef HAVE_DISK_JOURNAL
+        disk_journal_write(IF_MD(fat_bpb->drive,) sector, 1);
+    #endif
+
         if (--copies == 0)
             break;
 
@@ -933,6 +963,9 @@ static int update_fat_entry16(struct bpb *fat_bpb, unsigned long entry,
 
     uint16_t curval = letoh16(sec[offset]);
 
+    if (curval && (curval < FAT16_EOF_MARK || !val))
+        fat_chain_changed();
+
     if (val)
     {
         /* being allocated */
@@ -1030,10 +1063,32 @@ static long find_free_cluster32(struct bpb *fat_bpb, long startcluster)
     unsigned long entry = startcluster;
     unsigned long sector = entry / CLUSTERS_PER_FAT_SECTOR;
     unsigned long offset = entry % CLUSTERS_PER_FAT_SECTOR;
+#if FAT_FREE_SUMMARY_GROUPS > 0
+    bool wholegroup = false; /* scan started at the beginning of the group */
+#endif
 
     for (unsigned long i = 0; i < fat_bpb->fatsize; i++)
     {
         unsigned long nr = (i + sector) % fat_bpb->fatsize;
+
+#if FAT_FREE_SUMMARY_GROUPS > 0
+        unsigned long secs = fat_bpb->freesum_secs;
+        unsigned long gsec = nr % secs;
+        /* sectors left in this group, which may be cut short by the FAT end */
+        unsigned long gleft = MIN(secs - gsec, fat_bpb->fatsize - nr);
+
+        if (FREESUM_GROUP(fat_bpb, nr) == 0)
+        {
+            /* nothing free here; move on to the next group */
+            i += gleft - 1;
+            offset = 0;
+            continue;
+        }
+
+        if (gsec == 0)
+            wholegroup = true;
+#endif /* FAT_FREE_SUMMARY_GROUPS */
+
         uint32_t *sec = cache_sector(fat_bpb, nr + fat_bpb->fatrgnstart);
         if (!sec)
             break;
@@ -1058,6 +1113,15 @@ static long find_free_cluster32(struct bpb *fat_bpb, long startcluster)
         }
 
         offset = 0;
+
+#if FAT_FREE_SUMMARY_GROUPS > 0
+        if (gleft == 1 && wholegroup)
+        {
+            /* went through the entire group without finding anything */
+            FREESUM_GROUP(fat_bpb, nr) = 0;
+            wholegroup = false;
+        }
+#endif /* FAT_FREE_SUMMARY_GROUPS */
     }
 
     DEBUGF("%s(%lx) == 0\n", __func__, startcluster);
@@ -1090,17 +1154,38 @@ static int update_fat_entry32(struct bpb *fat_bpb, unsigned long entry,
 
     uint32_t curval = letoh32(sec[offset]);
 
+    if ((curval & 0x0fffffff) &&
+        ((curval & 0x0fffffff) < FAT_EOF_MARK || !val))
+        fat_chain_changed();
+
+#if FAT_FREE_SUMMARY_GROUPS > 0
+    uint32_t *freesum = &FREESUM_GROUP(fat_bpb, sector);
+#endif
+
     if (val)
     {
         /* being allocated */
-        if (!(curval & 0x0fffffff) && fat_bpb->fsinfo.freecount > 0)
-            fat_bpb->fsinfo.freecount--;
+        if (!(curval & 0x0fffffff))
+        {
+            if (fat_bpb->fsinfo.freecount > 0)
+                fat_bpb->fsinfo.freecount--;
+#if FAT_FREE_SUMMARY_GROUPS > 0
+            if (*freesum != FREESUM_UNKNOWN && *freesum > 0)
+                (*freesum)--;
+#endif
+        }
     }
     else
     {
         /* being freed */
         if (curval & 0x0fffffff)
+        {
             fat_bpb->fsinfo.freecount++;
+#if FAT_FREE_SUMMARY_GROUPS > 0
+            if (*freesum != FREESUM_UNKNOWN)
+                (*freesum)++;
+#endif
+        }
     }
 
     DEBUGF("%lu free clusters\n", (unsigned long)fat_bpb->fsinfo.freecount);
@@ -1119,9 +1204,19 @@ static void fat_recalc_free_internal32(struct bpb *fat_bpb)
 
     for (unsigned long i = 0; i < fat_bpb->fatsize; i++)
     {
+#if FAT_FREE_SUMMARY_GROUPS > 0
+        if (i % fat_bpb->freesum_secs == 0)
+            FREESUM_GROUP(fat_bpb, i) = 0;
+#endif
+
         uint32_t *sec = cache_sector(fat_bpb, i + fat_bpb->fatrgnstart);
         if (!sec)
+        {
+#if FAT_FREE_SUMMARY_GROUPS > 0
+            FREESUM_GROUP(fat_bpb, i) = FREESUM_UNKNOWN;
+#endif
             break;
+        }
 
         for (unsigned long j = 0; j < CLUSTERS_PER_FAT_SECTOR; j++)
         {
@@ -1134,6 +1229,9 @@ static void fat_recalc_free_internal32(struct bpb *fat_bpb)
                 continue;
 
             free++;
+#if FAT_FREE_SUMMARY_GROUPS > 0
+            FREESUM_GROUP(fat_bpb, i)++;
+#endif
             if (fat_bpb->fsinfo.nextfree == 0xffffffff)
                 fat_bpb->fsinfo.nextfree = c;
         }
@@ -1143,6 +1241,195 @@ static void fat_recalc_free_internal32(struct bpb *fat_bpb)
     update_fsinfo32(fat_bpb);
 }
 
+
+/** Cluster extent cache **/
+
+#if FAT_EXTENT_CACHE_SIZE > 0
+/* return the stream's extents, discarding them if they are out of date */
+static struct fat_extent_cache * extent_cache_get(struct fat_filestr *filestr)
+{
+    struct fat_extent_cache *ec = &filestr->extents;
+    long firstcluster = filestr->fatfilep->firstcluster;
+
+    if (ec->gen != fat_chain_gen || ec->firstcluster != firstcluster)
+    {
+        ec->firstcluster = firstcluster;
+        ec->gen          = fat_chain_gen;
+        ec->count        = 0;
+    }
+
+    return ec;
+}
+
+/* find the last extent starting at or before clusternum; -1 if none */
+static int extent_find(const struct fat_extent_cache *ec, long clusternum)
+{
+    int lo = 0, hi = ec->count - 1, i = -1;
+
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (ec->ext[mid].clusternum <= clusternum)
+        {
+            i = mid;
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+
+    return i;
+}
+
+/* insert a single-cluster extent at index i, making room by evicting the
+   shortest extent other than the one just before it; returns the index
+   where the new extent ended up */
+static int extent_insert(struct fat_extent_cache *ec, int i, long clusternum,
+                         long cluster)
+{
+    if (ec->count >= FAT_EXTENT_CACHE_SIZE)
+    {
+        int victim = -1;
+        for (int j = 0; j < ec->count; j++)
+        {
+            if (j != i - 1 &&
+                (victim < 0 || ec->ext[j].count < ec->ext[victim].count))
+                victim = j;
+        }
+
+        if (victim < 0)
+            victim = 0;
+
+        ec->count--;
+        memmove(&ec->ext[victim], &ec->ext[victim + 1],
+                (ec->count - victim) * sizeof (struct fat_extent));
+
+        if (victim < i)
+            i--;
+    }
+
+    memmove(&ec->ext[i + 1], &ec->ext[i],
+            (ec->count - i) * sizeof (struct fat_extent));
+    ec->ext[i].clusternum = clusternum;
+    ec->ext[i].cluster    = cluster;
+    ec->ext[i].count      = 1;
+    ec->count++;
+
+    return i;
+}
+
+/* walk from cluster (at index fromnum) to index clusternum of the file,
+   using known runs to skip most of the chain and remembering whatever had to
+   be read from the FAT */
+static long extent_cache_walk(struct bpb *fat_bpb,
+                              struct fat_filestr *filestr,
+                              long fromnum, long cluster, long clusternum)
+{
+    struct fat_extent_cache *ec = extent_cache_get(filestr);
+    struct fat_extent *e;
+    int i = extent_find(ec, clusternum);
+
+    if (i >= 0)
+    {
+        e = &ec->ext[i];
+        long endnum = e->clusternum + e->count - 1;
+
+        if (clusternum <= endnum)
+        {
+            fat_extent_stats.hits++;
+            return e->cluster + (clusternum - e->clusternum);
+        }
+
+        if (endnum >= fromnum)
+        {
+            /* continue from the end of the run */
+            fromnum = endnum;
+            cluster = e->cluster + e->count - 1;
+        }
+        else
+        {
+            i = extent_insert(ec, i + 1, fromnum, cluster);
+        }
+    }
+    else
+    {
+        i = extent_insert(ec, 0, fromnum, cluster);
+    }
+
+    fat_extent_stats.misses++;
+
+    /* (fromnum, cluster) is always the last cluster of extent i here */
+    while (fromnum < clusternum)
+    {
+        e = &ec->ext[i];
+
+        if (i + 1 < ec->count && ec->ext[i + 1].clusternum == fromnum + 1)
+        {
+            /* the chain is known from here; hop over the next run */
+            if (ec->ext[i + 1].cluster == cluster + 1)
+            {
+                e->count += ec->ext[i + 1].count;
+                ec->count--;
+                memmove(&ec->ext[i + 1], &ec->ext[i + 2],
+                        (ec->count - i - 1) * sizeof (struct fat_extent));
+            }
+            else
+            {
+                e = &ec->ext[++i];
+            }
+
+            fromnum = e->clusternum + e->count - 1;
+            if (clusternum <= fromnum)
+                return e->cluster + (clusternum - e->clusternum);
+
+            cluster = e->cluster + e->count - 1;
+            continue;
+        }
+
+        long next = get_next_cluster(fat_bpb, cluster);
+        fat_extent_stats.fatreads++;
+
+        if (next <= 0)
+            return next;
+
+        fromnum++;
+
+        if (next == cluster + 1)
+            e->count++;
+        else
+            i = extent_insert(ec, i + 1, fromnum, next);
+
+        cluster = next;
+    }
+
+    return cluster;
+}
+#endif /* FAT_EXTENT_CACHE_SIZE */
+
+/* return the cluster at index clusternum of a file, given that cluster is
+   at index fromnum <= clusternum */
+static long extent_get_cluster(struct bpb *fat_bpb,
+                               struct fat_filestr *filestr,
+                               long fromnum, long cluster, long clusternum)
+{
+#if FAT_EXTENT_CACHE_SIZE > 0
+#ifdef HAVE_FAT16SUPPORT
+    if (cluster >= 0) /* FAT16 root dir doesn't use the FAT */
+#endif
+        return extent_cache_walk(fat_bpb, filestr, fromnum, cluster,
+                                 clusternum);
+#endif /* FAT_EXTENT_CACHE_SIZE */
+
+    (void)filestr;
+
+    for (; fromnum < clusternum && cluster; fromnum++)
+        cluster = get_next_cluster(fat_bpb, cluster);
+
+    return cluster;
+}
+
 static int fat_mount_internal(struct bpb *fat_bpb)
 {
     int rc;
@@ -1298,6 +1585,14 @@ static int fat_mount_internal(struct bpb *fat_bpb)
         fat_bpb->fsinfo.nextfree = BYTES2INT32(buf, FSINFO_NEXTFREE);
     }
 
+#if FAT_FREE_SUMMARY_GROUPS > 0
+    /* groups get counted as they are scanned by the allocator or all at
+       once if the free count has to be recalculated */
+    fat_bpb->freesum_secs = (fat_bpb->fatsize + FAT_FREE_SUMMARY_GROUPS - 1)
+                                / FAT_FREE_SUMMARY_GROUPS;
+    memset(fat_bpb->freesum, 0xff, sizeof (fat_bpb->freesum));
+#endif
+
 #ifdef HAVE_FAT16SUPPORT
     /* Fix up calls that change per FAT type */
     if (fat_bpb->is_fat16)
@@ -2148,6 +2443,64 @@ int fat_open_rootdir(IF_MV(int volume,) struct fat_file *dir)
     return 0;
 }
 
+#ifdef HAVE_DISK_JOURNAL
+int fat_dir_written(const struct fat_file *dir)
+{
+    struct bpb * const fat_bpb = FAT_BPB(dir->volume);
+    if (!fat_bpb)
+        return -1;
+
+    long cluster = dir->firstcluster;
+    unsigned long sector;
+    int rc;
+
+#ifdef HAVE_FAT16SUPPORT
+    if (fat_bpb->is_fat16 && cluster < 0)
+    {
+        /* the root directory area just ahead of the data */
+        sector = cluster2sec(fat_bpb, cluster);
+        return disk_journal_written(IF_MD(fat_bpb->drive,)
+                                    sector + fat_bpb->startsector,
+                                    fat_bpb->firstdatasector - sector);
+    }
+#endif /* HAVE_FAT16SUPPORT */
+
+    for (unsigned long count = 0; cluster; count++)
+    {
+        if (cluster < 0 || count >= fat_bpb->dataclusters)
+            return -1; /* bad chain */
+
+        sector = cluster2sec(fat_bpb, cluster);
+        if (!sector)
+            return -1;
+
+        rc = disk_journal_written(IF_MD(fat_bpb->drive,)
+                                  sector + fat_bpb->startsector,
+                                  fat_bpb->bpb_secperclus);
+        if (rc)
+            return rc;
+
+        /* the FAT sector holding its link to the next cluster */
+    #ifdef HAVE_FAT16SUPPORT
+        if (fat_bpb->is_fat16)
+            sector = cluster / CLUSTERS_PER_FAT16_SECTOR;
+        else
+    #endif
+            sector = cluster / CLUSTERS_PER_FAT_SECTOR;
+
+        rc = disk_journal_written(IF_MD(fat_bpb->drive,)
+                                  sector + fat_bpb->fatrgnstart +
+                                  fat_bpb->startsector, 1);
+        if (rc)
+            return rc;
+
+        cluster = get_next_cluster(fat_bpb, cluster);
+    }
+
+    return 0;
+}
+#endif /* HAVE_DISK_JOURNAL */
+
 int fat_remove(struct fat_file *file, enum fat_remove_op what)
 {
     struct bpb * const fat_bpb = FAT_BPB(file->volume);
@@ -2572,8 +2925,10 @@ long fat_readwrite(struct fat_filestr *filestr, unsigned long sectorcount,
         if (++sectornum >= fat_bpb->bpb_secperclus)
         {
             /* out of sectors in this cluster; get the next cluster */
-            long newcluster = write ? next_write_cluster(fat_bpb, cluster) :
-                                      get_next_cluster(fat_bpb, cluster);
+            long newcluster = write ?
+                next_write_cluster(fat_bpb, cluster) :
+                extent_get_cluster(fat_bpb, filestr, clusternum, cluster,
+                                   clusternum + 1);
             if (newcluster)
             {
                 cluster = newcluster;
@@ -2642,6 +2997,9 @@ void fat_rewind(struct fat_filestr *filestr)
     filestr->clusternum   = 0;
     filestr->sectornum    = FAT_FILE_RW_VAL;
     filestr->eof          = false;
+#if FAT_EXTENT_CACHE_SIZE > 0
+    filestr->extents.count = 0;
+#endif
 }
 
 void fat_seek_to_stream(struct fat_filestr *filestr,
@@ -2689,25 +3047,22 @@ int fat_seek(struct fat_filestr *filestr, unsigned long seeksector)
         clusternum = seeksector / fat_bpb->bpb_secperclus;
         sectornum = seeksector % fat_bpb->bpb_secperclus;
 
-        long numclusters = clusternum;
+        long fromnum = 0;
 
         if (filestr->clusternum && clusternum >= filestr->clusternum)
         {
             /* seek forward from current position */
             cluster = filestr->lastcluster;
-            numclusters -= filestr->clusternum;
+            fromnum = filestr->clusternum;
         }
 
-        for (long i = 0; i < numclusters; i++)
+        cluster = extent_get_cluster(fat_bpb, filestr, fromnum, cluster,
+                                     clusternum);
+        if (!cluster)
         {
-            cluster = get_next_cluster(fat_bpb, cluster);
-
-            if (!cluster)
-            {
-                DEBUGF("Seeking beyond the end of the file! "
-                       "(sector %lu, cluster %ld)\n", seeksector, i);
-                FAT_ERROR(FAT_SEEK_EOF);
-            }
+            DEBUGF("Seeking beyond the end of the file! "
+                   "(sector %lu, cluster %ld)\n", seeksector, clusternum);
+            FAT_ERROR(FAT_SEEK_EOF);
         }
 
         sector = cluster2sec(fat_bpb, cluster) + sectornum;
@@ -3018,6 +3373,13 @@ bool fat_size(IF_MV(int volume,) sector_t *size, sector_t *free)
 
 /** Misc. **/
 
+#if FAT_EXTENT_CACHE_SIZE > 0
+void fat_get_extent_stats(struct fat_extent_stats *stats)
+{
+    *stats = fat_extent_stats;
+}
+#endif /* FAT_EXTENT_CACHE_SIZE */
+
 void fat_empty_fat_direntry(struct fat_direntry *entry)
 {
     entry->name[0]      = 0;
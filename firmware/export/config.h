@@ -1010,6 +1010,12 @@ Lyre prototype 1 */
 #define HAVE_SCHEDULER_BOOSTCTRL
 #endif /* PLATFORM_NATIVE */
 
+/* Per-thread run/ready/blocked times and switch counts kept by the scheduler
+   (see "View thread stats"); undefine to compile the bookkeeping out */
+#ifndef HAVE_SDL_THREADS
+#define HAVE_THREAD_STATS
+#endif
+
 
 #ifdef HAVE_USBSTACK
 #if CONFIG_USBOTG == USBOTG_ARC
@@ -1108,6 +1114,14 @@ Lyre prototype 1 */
 #define CODEC_SIZE 0
 #endif
 
+/* Keep recently used codec images in a part of the audio buffer so that going
+ * back to a format doesn't load its codec from disk again */
+#if (CONFIG_PLATFORM & PLATFORM_NATIVE) && !defined(BOOTLOADER) && \
+    CODEC_SIZE > 0 && MEMORYSIZE >= 16
+#define HAVE_CODEC_CACHE
+#define CODEC_CACHE_SIZE (MEMORYSIZE >= 32 ? 0x100000 : 0x80000)
+#endif
+
 /* This attribute can be used to ensure that certain symbols are never profiled
  * which can be important as profiling a function de-inlines it */
 #ifdef RB_PROFILE
@@ -1351,6 +1365,15 @@ Lyre prototype 1 */
 
 #endif /* HAVE_USBSTACK */
 
+/* Record which sectors USB mass storage writes so that the dircache can keep
+   the directories a USB session didn't touch instead of rescanning them all;
+   virtual sector targets are left out since USB storage rescales their
+   sector numbers */
+#if defined(HAVE_DIRCACHE) && defined(USB_ENABLE_STORAGE) && \
+    !defined(USB_USE_RAMDISK) && !defined(MAX_VIRT_SECTOR_SIZE)
+#define HAVE_DISK_JOURNAL
+#endif
+
 /* This attribute can be used to enable to detection of plugin file handles leaks.
  * When enabled, the plugin core will monitor open/close/creat and when the plugin exits
  * will display an error message if the plugin leaked some file handles */
@@ -1367,6 +1390,21 @@ Lyre prototype 1 */
 #define HAVE_PITCHCONTROL
 #endif
 
+/* Hosted targets have the CPU to spare for the windowed-sinc resampler */
+#if (CONFIG_PLATFORM & PLATFORM_HOSTED) && !defined(BOOTLOADER)
+#define HAVE_RESAMPLE_SINC
+#endif
+
+/* Targets with a 32-bit ALSA sink carry decoded audio through pcmbuf and
+   the mixer at more than 16 bits; depth may be lowered per target. The
+   simulators of those targets play through the 16-bit SDL sink. */
+#if defined(HAVE_ALSA_32BIT) && !defined(BOOTLOADER) && !defined(SIMULATOR)
+#define HAVE_PCM_HIRES
+#ifndef PCM_HIRES_DEPTH
+#define PCM_HIRES_DEPTH 24
+#endif
+#endif
+
 /* enable logging messages to disk*/
 #if !defined(BOOTLOADER) && !defined(__PCTOOL__)
 #define ROCKBOX_HAS_LOGDISKF
@@ -65,4 +65,16 @@ int disk_get_log_sector_size(IF_MD_NONVOID(int drive));
 
 bool disk_present(IF_MD_NONVOID(int drive));
 
+#ifdef HAVE_DISK_JOURNAL
+/* Sector write journal: while open, writes reported to it are remembered
+   per drive so that cached filesystem metadata can be checked for changes
+   afterwards. disk_journal_written() returns > 0 if any sector in the range
+   was written, 0 if none was or < 0 if that can't be known. */
+void disk_journal_open(void);
+void disk_journal_close(void);
+void disk_journal_write(IF_MD(int drive,) sector_t start, unsigned long count);
+int disk_journal_written(IF_MD(int drive,) sector_t start,
+                         unsigned long count);
+#endif /* HAVE_DISK_JOURNAL */
+
 #endif /* _DISK_H_ */
@@ -50,6 +50,20 @@ static FORCE_INLINE int32_t clip_sample_16(int32_t sample)
 
 #undef CLIP_SAMPLE_16_DEFINED
 
+/** Clip sample to signed range of the given bit depth (2..31) **/
+static FORCE_INLINE int32_t clip_sample_depth(int32_t sample,
+                                              unsigned int depth)
+{
+    int32_t max = (1L << (depth - 1)) - 1;
+
+    if (sample > max)
+        sample = max;
+    else if (sample < -max - 1)
+        sample = -max - 1;
+
+    return sample;
+}
+
 /* Absolute difference of signed 32-bit numbers which must be dealt with
  * in the unsigned 32-bit range */
 static FORCE_INLINE uint32_t ad_s32(int32_t a, int32_t b)
@@ -48,6 +48,26 @@
 #define FAT_MAX_TRANSFER_SIZE 256
 #endif
 
+/* number of contiguous cluster runs each open stream remembers in order to
+ * seek without walking the cluster chain; 0 disables the extent cache */
+#ifndef FAT_EXTENT_CACHE_SIZE
+#ifdef BOOTLOADER
+#define FAT_EXTENT_CACHE_SIZE 0
+#else
+#define FAT_EXTENT_CACHE_SIZE 8
+#endif
+#endif
+
+/* number of FAT32 regions whose free cluster counts are kept in RAM so the
+ * allocator can skip full parts of the FAT; 0 disables the summary */
+#ifndef FAT_FREE_SUMMARY_GROUPS
+#ifdef BOOTLOADER
+#define FAT_FREE_SUMMARY_GROUPS 0
+#else
+#define FAT_FREE_SUMMARY_GROUPS 512
+#endif
+#endif
+
 /**
  ****************************************************************************/
 
@@ -114,6 +134,25 @@ struct fat_file
     struct fat_dirscan_info e;  /* entry information */
 };
 
+#if FAT_EXTENT_CACHE_SIZE > 0
+/* a run of clusters that are contiguous on disk */
+struct fat_extent
+{
+    long clusternum;            /* index of the first cluster in the file */
+    long cluster;               /* first cluster of the run */
+    long count;                 /* number of clusters in the run */
+};
+
+/* the runs of a file's cluster chain seen so far, sorted by clusternum */
+struct fat_extent_cache
+{
+    long         firstcluster;  /* file the runs belong to */
+    unsigned int gen;           /* FAT chain generation of the runs */
+    int          count;         /* number of runs in ext[] */
+    struct fat_extent ext[FAT_EXTENT_CACHE_SIZE];
+};
+#endif /* FAT_EXTENT_CACHE_SIZE */
+
 /* this stores what was last accessed when read or writing a file's data */
 struct fat_filestr
 {
@@ -123,6 +162,9 @@ struct fat_filestr
     long          clusternum;   /* cluster number of last access */
     unsigned long sectornum;    /* sector number within current cluster */
     bool          eof;          /* end-of-file reached */
+#if FAT_EXTENT_CACHE_SIZE > 0
+    struct fat_extent_cache extents; /* known cluster runs */
+#endif
 };
 
 /** File entity functions **/
@@ -135,6 +177,11 @@ int fat_fstat(struct fat_file *file, struct fat_direntry *entry);
 int fat_open(const struct fat_file *parent, long startcluster,
              struct fat_file *file);
 int fat_open_rootdir(IF_MV(int volume,) struct fat_file *dir);
+#ifdef HAVE_DISK_JOURNAL
+/* > 0 if the directory's clusters or their FAT entries were written while
+   the disk journal was open, 0 if not, < 0 if unknown */
+int fat_dir_written(const struct fat_file *dir);
+#endif
 enum fat_remove_op           /* what should fat_remove(), remove? */
 {
     FAT_RM_DIRENTRIES = 0x1, /* remove only directory entries */
@@ -184,6 +231,15 @@ int fat_get_bytes_per_sector(IF_MV_NONVOID(int volume));
 unsigned int fat_get_cluster_size(IF_MV_NONVOID(int volume));
 void fat_recalc_free(IF_MV_NONVOID(int volume));
 bool fat_size(IF_MV(int volume,) sector_t *size, sector_t *free);
+#if FAT_EXTENT_CACHE_SIZE > 0
+struct fat_extent_stats
+{
+    unsigned long hits;         /* lookups answered from known runs */
+    unsigned long misses;       /* lookups that had to read the FAT */
+    unsigned long fatreads;     /* FAT entries read by lookups */
+};
+void fat_get_extent_stats(struct fat_extent_stats *stats);
+#endif /* FAT_EXTENT_CACHE_SIZE */
 
 /** Misc. **/
 void fat_empty_fat_direntry(struct fat_direntry *entry);
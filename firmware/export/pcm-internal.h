@@ -70,6 +70,17 @@ void pcm_sync_pcm_factors(void);
 void pcm_do_peak_calculation(struct pcm_peaks *peaks, bool active,
                              const void *addr, int count);
 
+#ifdef HAVE_PCM_HIRES
+/* Sample depth of the data being played: 16 after pcm_play_data(),
+   PCM_HIRES_DEPTH after pcm_play_data_hires() */
+extern unsigned int pcm_play_depth;
+
+/* As pcm_do_peak_calculation() for high-resolution frames; peaks are
+   reported in the 16-bit range */
+void pcm_do_peak_calculation_hires(struct pcm_peaks *peaks, bool active,
+                                   const void *addr, int count);
+#endif /* HAVE_PCM_HIRES */
+
 /** The following are for internal use between pcm.c and target-
     specific portion **/
 /* Call registered callback to obtain next buffer */
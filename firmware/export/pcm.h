@@ -76,6 +76,17 @@ void pcm_play_data(pcm_play_callback_type get_more,
                    pcm_status_callback_type status_cb,
                    const void *start, size_t size);
 
+#ifdef HAVE_PCM_HIRES
+/* High-resolution frames: interleaved stereo with PCM_HIRES_DEPTH-bit
+   samples sign-extended into 32-bit words */
+#define PCM_HIRES_SAMPLE_SIZE   (2 * sizeof (int32_t))
+
+/* As pcm_play_data() for data in the high-resolution format */
+void pcm_play_data_hires(pcm_play_callback_type get_more,
+                         pcm_status_callback_type status_cb,
+                         const void *start, size_t size);
+#endif /* HAVE_PCM_HIRES */
+
 /* Kept internally for global PCM and used by mixer's verion of peak
    calculation */
 struct pcm_peaks
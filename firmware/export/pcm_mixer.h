@@ -99,6 +99,14 @@ void mixer_channel_play_data(enum pcm_mixer_channel channel,
                              pcm_play_callback_type get_more,
                              const void *start, size_t size);
 
+#ifdef HAVE_PCM_HIRES
+/* Start playback on a channel with data in the high-resolution format
+   (see PCM_HIRES_SAMPLE_SIZE); it is mixed with 16-bit channels */
+void mixer_channel_play_data_hires(enum pcm_mixer_channel channel,
+                                   pcm_play_callback_type get_more,
+                                   const void *start, size_t size);
+#endif
+
 /* Pause or resume a channel (when started) */
 void mixer_channel_play_pause(enum pcm_mixer_channel channel, bool play);
 
@@ -115,7 +123,8 @@ enum channel_status mixer_channel_status(enum pcm_mixer_channel channel);
 /* Returns amount data remaining in channel before next callback */
 size_t mixer_channel_get_bytes_waiting(enum pcm_mixer_channel channel);
 
-/* Return pointer to channel's playing audio data and the size remaining */
+/* Return pointer to channel's playing audio data and the frames remaining;
+   data of a high-resolution channel is in that format */
 const void * mixer_channel_get_buffer(enum pcm_mixer_channel channel,
                                       int *count);
 
@@ -374,6 +374,28 @@ void* buflib_buffer_out(struct buflib_context *ctx, size_t *size);
  */
 void buflib_buffer_in(struct buflib_context *ctx, int size);
 
+/**
+ * Allocator statistics, counted from buflib_init()
+ */
+struct buflib_stats
+{
+    unsigned long allocs;       /* successful allocations */
+    unsigned long frees;
+    unsigned long walks;        /* searches that walked the block list */
+    unsigned long walk_blocks;  /* blocks visited by those searches */
+    unsigned long walk_max;     /* blocks visited by the longest one */
+    unsigned long index_hits;   /* searches answered by the free index */
+    unsigned long compactions;
+    unsigned long bytes_moved;  /* by compaction */
+};
+
+/**
+ * \brief Get the allocator statistics of a context
+ * \param ctx       Context to query
+ * \param stats     Filled in with the counters
+ */
+void buflib_get_stats(struct buflib_context *ctx, struct buflib_stats *stats);
+
 #ifdef BUFLIB_DEBUG_PRINT
 /**
  * Return the number of blocks in the buffer, allocated or unallocated.
@@ -53,6 +53,11 @@ union buflib_data
                                      Used during compaction for fast lookup */
 };
 
+/* Number of free blocks the free-block index can track, 0 to disable it */
+#ifndef BUFLIB_FREE_INDEX_SIZE
+#define BUFLIB_FREE_INDEX_SIZE 32
+#endif
+
 struct buflib_context
 {
     union buflib_data *handle_table;
@@ -61,6 +66,13 @@ struct buflib_context
     union buflib_data *buf_start;
     union buflib_data *alloc_end;
     bool compact;
+#if BUFLIB_FREE_INDEX_SIZE > 0
+    /* free blocks below alloc_end in address order, see buflib_mempool.c */
+    int free_index_len;
+    int free_index_retry;
+    union buflib_data *free_index[BUFLIB_FREE_INDEX_SIZE];
+#endif
+    struct buflib_stats stats;
 };
 
 #define BUFLIB_ALLOC_OVERHEAD (BUFLIB_NUM_FIELDS * sizeof(union buflib_data))
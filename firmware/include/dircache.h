@@ -51,6 +51,16 @@
 #define DIRCACHE_MIN     (1024*1024*1) /* 1 MB - provision min size */
 #define DIRCACHE_LIMIT   (1024*1024*6) /* 6 MB - provision max size */
 
+/* directories with at least DIRCACHE_HASH_MIN entries get a name hash index
+   so that path components resolve without walking the whole directory; up
+   to DIRCACHE_HASH_DIRS of them share a static pool of DIRCACHE_HASH_SLOTS
+   entry indexes (4 bytes each) and the least recently used is evicted */
+#if (CONFIG_PLATFORM & PLATFORM_NATIVE) && MEMORYSIZE >= 32
+#define DIRCACHE_HASH_MIN   64
+#define DIRCACHE_HASH_DIRS  16
+#define DIRCACHE_HASH_SLOTS (MEMORYSIZE*256)
+#endif
+
 /* make it easy to change serialnumber size without modifying anything else;
    32 bits allows 21845 builds before wrapping in a 6MB cache that is filled
    exclusively with entries and nothing else (32 byte entries), making that
@@ -124,6 +134,11 @@ int dircache_readdir_internal(struct filestr_base *stream,
                               struct file_base_info *infop,
                               struct fat_direntry *fatent);
 void dircache_rewinddir_internal(struct file_base_info *info);
+#ifdef DIRCACHE_HASH_SLOTS
+int dircache_find_internal(struct filestr_base *stream, const char *name,
+                           struct file_base_info *infop,
+                           struct fat_direntry *fatent);
+#endif /* DIRCACHE_HASH_SLOTS */
 #endif /* DIRCACHE_NATIVE */
 
 
@@ -191,6 +191,22 @@ int core_get_debug_info(unsigned int core, struct core_debug_info *infop);
 #define IFN_SDL(x...) x
 #endif
 
+#ifdef HAVE_THREAD_STATS
+/* Scheduler statistics kept per thread; times are in microseconds but only
+   have tick resolution on targets without USEC_TIMER */
+struct thread_stats
+{
+    uint64_t      run_time;       /* Time spent on the CPU */
+    uint64_t      ready_time;     /* Time spent runnable waiting for the CPU */
+    uint64_t      blocked_time;   /* Time spent blocked on kernel objects */
+    unsigned long switches;       /* Number of times switched in */
+    unsigned long blocks;         /* Number of blocks on kernel objects */
+    unsigned long max_ready;      /* Longest wait for the CPU once runnable */
+    unsigned long max_blocked;    /* Longest single block */
+    const void   *max_blocked_on; /* Wait queue of the longest block */
+};
+#endif /* HAVE_THREAD_STATS */
+
 struct thread_debug_info
 {
     char         statusstr[4];
@@ -205,6 +221,9 @@ struct thread_debug_info
     int          base_priority;
     int          current_priority;
 #endif
+#ifdef HAVE_THREAD_STATS
+    struct thread_stats stats;
+#endif
 };
 int thread_get_debug_info(unsigned int thread_id,
                           struct thread_debug_info *infop);
@@ -314,6 +314,9 @@ int thread_get_debug_info(unsigned int thread_id,
         infop->base_priority = thread->base_priority;
         infop->current_priority = thread->priority;
 #endif
+#ifdef HAVE_THREAD_STATS
+        infop->stats = thread->stats;
+#endif
 
         snprintf(infop->statusstr, sizeof (infop->statusstr), "%c%c",
                  cpu_boost ? '+' : (state == STATE_RUNNING ? '*' : ' '),
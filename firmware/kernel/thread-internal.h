@@ -134,6 +134,11 @@ struct thread_entry
 #ifndef HAVE_SDL_THREADS
     size_t stack_size;           /* Size of stack in bytes */
 #endif
+#ifdef HAVE_THREAD_STATS
+    unsigned long stats_stamp;   /* Clock at the last scheduling change */
+    const void *stats_wqp;       /* Wait queue of the current block */
+    struct thread_stats stats;   /* Accumulated scheduler statistics */
+#endif
 };
 
 /* Thread ID, 32 bits = |VVVVVVVV|VVVVVVVV|VVVVVVVV|SSSSSSSS| */
@@ -145,6 +150,16 @@ struct thread_entry
 
 #define DEADBEEF ((uintptr_t)0xdeadbeefdeadbeefull)
 
+#ifdef HAVE_THREAD_STATS
+/* Microsecond clock for the scheduler statistics; only differences are
+   used so wraparound is harmless for intervals shorter than ~71 minutes */
+#ifdef USEC_TIMER
+#define THREAD_STATS_CLOCK() ((unsigned long)USEC_TIMER)
+#else
+#define THREAD_STATS_CLOCK() ((unsigned long)current_tick * (1000000 / HZ))
+#endif
+#endif /* HAVE_THREAD_STATS */
+
 /* Information kept for each core
  * Members are arranged for the same reason as in thread_entry
  */
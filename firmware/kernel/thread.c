@@ -370,6 +370,11 @@ static void new_thread_base_init(struct thread_entry *thread,
 #ifdef HAVE_SCHEDULER_BOOSTCTRL
     thread->cpu_boost = 0;
 #endif
+#ifdef HAVE_THREAD_STATS
+    thread->stats_stamp = THREAD_STATS_CLOCK();
+    thread->stats_wqp = NULL;
+    memset(&thread->stats, 0, sizeof (thread->stats));
+#endif
 }
 
 /*---------------------------------------------------------------------------
@@ -384,6 +389,22 @@ static inline void core_rtr_add(struct core_entry *corep,
     rtr_add_entry(corep, thread->priority);
 #ifdef HAVE_PRIORITY_SCHEDULING
     thread->skip_count = thread->base_priority;
+#endif
+#ifdef HAVE_THREAD_STATS
+    /* Close the blocked interval and start waiting for the CPU */
+    unsigned long now = THREAD_STATS_CLOCK();
+    if (thread->state == STATE_BLOCKED ||
+        thread->state == STATE_BLOCKED_W_TMO)
+    {
+        unsigned long blocked = now - thread->stats_stamp;
+        thread->stats.blocked_time += blocked;
+        if (blocked > thread->stats.max_blocked)
+        {
+            thread->stats.max_blocked = blocked;
+            thread->stats.max_blocked_on = thread->stats_wqp;
+        }
+    }
+    thread->stats_stamp = now;
 #endif
     thread->state = STATE_RUNNING;
     RTR_UNLOCK(corep);
@@ -1022,6 +1043,11 @@ void switch_thread(void)
 #ifdef BUFLIB_DEBUG_CHECK_VALID
         /* Check core_ctx buflib integrity */
         core_check_valid();
+#endif
+#ifdef HAVE_THREAD_STATS
+        unsigned long now = THREAD_STATS_CLOCK();
+        thread->stats.run_time += now - thread->stats_stamp;
+        thread->stats_stamp = now;
 #endif
         thread_store_context(thread);
 
@@ -1096,6 +1122,16 @@ void switch_thread(void)
     rtr_queue_make_first(&corep->rtr, thread);
     corep->running = thread;
 
+#ifdef HAVE_THREAD_STATS
+    unsigned long now = THREAD_STATS_CLOCK();
+    unsigned long ready = now - thread->stats_stamp;
+    thread->stats.ready_time += ready;
+    if (ready > thread->stats.max_ready)
+        thread->stats.max_ready = ready;
+    thread->stats.switches++;
+    thread->stats_stamp = now;
+#endif
+
     RTR_UNLOCK(corep);
     enable_irq();
 
@@ -1145,6 +1181,10 @@ void block_thread_(struct thread_entry *current, int timeout)
 
     wait_queue_register(current);
     prepare_block(current, STATE_BLOCKED, timeout);
+#ifdef HAVE_THREAD_STATS
+    current->stats_wqp = current->wqp;
+    current->stats.blocks++;
+#endif
 
 #ifdef HAVE_PRIORITY_SCHEDULING
     if (bl != NULL)
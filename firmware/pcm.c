@@ -95,6 +95,10 @@ unsigned long pcm_curr_sampr SHAREDBSS_ATTR = 0;
 unsigned long pcm_sampr SHAREDBSS_ATTR = HW_SAMPR_DEFAULT;
 /* samplerate frequency selection index */
 int pcm_fsel SHAREDBSS_ATTR = HW_FREQ_DEFAULT;
+#ifdef HAVE_PCM_HIRES
+/* sample depth of the data being played */
+unsigned int pcm_play_depth SHAREDBSS_ATTR = 16;
+#endif
 
 static void pcm_play_data_start_int(const void *addr, size_t size);
 void pcm_play_stop_int(void);
@@ -135,6 +139,10 @@ bool pcm_play_dma_complete_callback(enum pcm_dma_status status,
 static void pcm_play_data_start_int(const void *addr, size_t size)
 {
     ALIGN_AUDIOBUF(addr, size);
+#ifdef HAVE_PCM_HIRES
+    if (pcm_play_depth > 16)
+        size &= ~(PCM_HIRES_SAMPLE_SIZE - 1);
+#endif
 
     if ((addr && size) || pcm_get_more_int(&addr, &size))
     {
@@ -204,8 +212,43 @@ static void pcm_peak_peeker(const int16_t *p, int count,
     peaks->right = peak_r;
 }
 
-void pcm_do_peak_calculation(struct pcm_peaks *peaks, bool active,
-                             const void *addr, int count)
+#ifdef HAVE_PCM_HIRES
+/**
+ * Perform peak calculation on a buffer of high-resolution frames, scaling
+ * the results to the 16-bit range.
+ */
+static void pcm_peak_peeker_hires(const int32_t *p, int count,
+                                  struct pcm_peaks *peaks)
+{
+    uint32_t peak_l = 0, peak_r = 0;
+    const int32_t *pend = p + 2 * count;
+
+    do
+    {
+        uint32_t s;
+
+        s = p[0] < 0 ? -p[0] : p[0];
+
+        if (s > peak_l)
+            peak_l = s;
+
+        s = p[1] < 0 ? -p[1] : p[1];
+
+        if (s > peak_r)
+            peak_r = s;
+
+        p += 4 * 2; /* Every 4th sample, interleaved */
+    }
+    while (p < pend);
+
+    peaks->left = peak_l >> (PCM_HIRES_DEPTH - 16);
+    peaks->right = peak_r >> (PCM_HIRES_DEPTH - 16);
+}
+#endif /* HAVE_PCM_HIRES */
+
+/* Update the calling period and return how many frames may be peeked at */
+static int pcm_peak_frame_count(struct pcm_peaks *peaks, bool active,
+                                int count)
 {
     long tick = current_tick;
 
@@ -221,22 +264,38 @@ void pcm_do_peak_calculation(struct pcm_peaks *peaks, bool active,
     peaks->period = (3*peaks->period + period) / 4;
     peaks->tick = tick;
 
-    if (active)
-    {
-        int framecount = peaks->period*pcm_curr_sampr / HZ;
-        count = MIN(framecount, count);
-
-        if (count > 0)
-            pcm_peak_peeker(addr, count, peaks);
-        /* else keep previous peak values */
-    }
-    else
+    if (!active)
     {
         /* peaks are zero */
         peaks->left = peaks->right = 0;
+        return 0;
     }
+
+    /* If none, the previous peak values are kept */
+    int framecount = peaks->period*pcm_curr_sampr / HZ;
+    return MIN(framecount, count);
+}
+
+void pcm_do_peak_calculation(struct pcm_peaks *peaks, bool active,
+                             const void *addr, int count)
+{
+    count = pcm_peak_frame_count(peaks, active, count);
+
+    if (count > 0)
+        pcm_peak_peeker(addr, count, peaks);
 }
 
+#ifdef HAVE_PCM_HIRES
+void pcm_do_peak_calculation_hires(struct pcm_peaks *peaks, bool active,
+                                   const void *addr, int count)
+{
+    count = pcm_peak_frame_count(peaks, active, count);
+
+    if (count > 0)
+        pcm_peak_peeker_hires(addr, count, peaks);
+}
+#endif /* HAVE_PCM_HIRES */
+
 bool pcm_is_playing(void)
 {
     return pcm_playing;
@@ -286,12 +345,35 @@ void pcm_play_data(pcm_play_callback_type get_more,
 
     pcm_callback_for_more = get_more;
     pcm_play_status_callback = status_cb;
+#ifdef HAVE_PCM_HIRES
+    pcm_play_depth = 16;
+#endif
+
+    logf(" pcm_play_data_start_int");
+    pcm_play_data_start_int(start, size);
+
+    pcm_play_unlock();
+}
+
+#ifdef HAVE_PCM_HIRES
+void pcm_play_data_hires(pcm_play_callback_type get_more,
+                         pcm_status_callback_type status_cb,
+                         const void *start, size_t size)
+{
+    logf("pcm_play_data_hires");
+
+    pcm_play_lock();
+
+    pcm_callback_for_more = get_more;
+    pcm_play_status_callback = status_cb;
+    pcm_play_depth = PCM_HIRES_DEPTH;
 
     logf(" pcm_play_data_start_int");
     pcm_play_data_start_int(start, size);
 
     pcm_play_unlock();
 }
+#endif /* HAVE_PCM_HIRES */
 
 void pcm_play_stop(void)
 {
@@ -33,8 +33,15 @@
    before the last samples are sent to the codec and so things are done in
    parallel (as much as possible) with sending-out data. */
 
+#ifdef HAVE_PCM_HIRES
+/* The downmix is always high-resolution; channels may be either */
+#define MIX_SAMPLE_SIZE     PCM_HIRES_SAMPLE_SIZE
+#else
+#define MIX_SAMPLE_SIZE     PCM_SAMPLE_SIZE
+#endif
+
 static unsigned int mixer_sampr = HW_SAMPR_DEFAULT;
-static unsigned int mix_frame_size = MIX_FRAME_SAMPLES*4;
+static unsigned int mix_frame_size = MIX_FRAME_SAMPLES*MIX_SAMPLE_SIZE;
 
 /* Define this to nonzero to add a marker pulse at each frame start */
 #define FRAME_BOUNDARY_MARKERS 0
@@ -49,6 +56,9 @@ struct mixer_channel
     enum channel_status status;      /* Playback status */
     uint32_t amplitude;              /* Amp. factor: 0x0000 = mute, 0x10000 = unity */
     chan_buffer_hook_fn_type buffer_hook; /* Callback for new buffer */
+#ifdef HAVE_PCM_HIRES
+    bool hires;                      /* Data is in high-resolution format */
+#endif
 };
 
 #if (defined(HW_HAVE_192) || defined(HW_HAVE_176))
@@ -64,7 +74,7 @@ struct mixer_channel
 /* Because of the double-buffering, playback is always from here, otherwise a
    mechanism for the channel callbacks not to free buffers too early would be
    needed (if we _really_ want it and it's worth it, we _can_ do that ;-) ) */
-static uint32_t downmix_buf[2][MAX_MIX_FRAME_SAMPLES] DOWNMIX_BUF_IBSS MEM_ALIGN_ATTR;
+static uint32_t downmix_buf[2][MAX_MIX_FRAME_SAMPLES*MIX_SAMPLE_SIZE/4] DOWNMIX_BUF_IBSS MEM_ALIGN_ATTR;
 static int downmix_index = 0;   /* Which downmix_buf? */
 static size_t next_size = 0;    /* Size of buffer to play next time */
 
@@ -75,12 +85,93 @@ static struct mixer_channel channels[PCM_MIXER_NUM_CHANNELS] IBSS_ATTR;
 static struct mixer_channel * active_channels[PCM_MIXER_NUM_CHANNELS+1] IBSS_ATTR;
 
 /* Number of silence frames to play after all data has played */
-#define MAX_IDLE_FRAMES     (mixer_sampr*3 / (mix_frame_size / 4))
+#define MAX_IDLE_FRAMES     (mixer_sampr*3 / (mix_frame_size / MIX_SAMPLE_SIZE))
 static unsigned int idle_counter = 0;
 
 /** Mixing routines, CPU optmized **/
 #include "asm/pcm-mixer.c"
 
+#ifdef HAVE_PCM_HIRES
+/* Channel data size of a given downmix size and vice versa */
+static inline size_t mix_to_chan_size(const struct mixer_channel *chan,
+                                      size_t size)
+{
+    return chan->hires ? size : size / 2;
+}
+
+static inline size_t chan_to_mix_size(const struct mixer_channel *chan,
+                                      size_t size)
+{
+    return chan->hires ? size : size * 2;
+}
+
+/* Fetch sample i from either format, scaled to PCM_HIRES_DEPTH bits */
+static FORCE_INLINE int32_t hires_sample(const void *src, bool hires,
+                                         size_t i)
+{
+    if (hires)
+        return ((const int32_t *)src)[i];
+
+    return (int32_t)((const int16_t *)src)[i] << (PCM_HIRES_DEPTH - 16);
+}
+
+static FORCE_INLINE int32_t hires_amp(int32_t sample, int32_t amp)
+{
+    if (amp == MIX_AMP_UNITY)
+        return sample;
+
+    return (int64_t)sample * amp >> 16;
+}
+
+/* Mix channels' samples into the high-resolution downmix and apply gain
+   factors; size is that of the downmix */
+static void mix_samples_hires(int32_t *out,
+                              const void *src0, bool hires0, int32_t src0_amp,
+                              const void *src1, bool hires1, int32_t src1_amp,
+                              size_t size)
+{
+    size_t count = size / sizeof (int32_t);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t s = hires_amp(hires_sample(src0, hires0, i), src0_amp) +
+                    hires_amp(hires_sample(src1, hires1, i), src1_amp);
+        out[i] = clip_sample_depth(s, PCM_HIRES_DEPTH);
+    }
+}
+
+/* Write channel's samples to the high-resolution downmix and apply gain
+   factor; size is that of the downmix */
+static void write_samples_hires(int32_t *out, const void *src, bool hires,
+                                int32_t amp, size_t size)
+{
+    if (hires && amp == MIX_AMP_UNITY)
+    {
+        memcpy(out, src, size);
+        return;
+    }
+
+    size_t count = size / sizeof (int32_t);
+
+    for (size_t i = 0; i < count; i++)
+        out[i] = hires_amp(hires_sample(src, hires, i), amp);
+}
+
+#define write_samples(out, chan, size) \
+    write_samples_hires((out), (chan)->start, (chan)->hires, \
+                        (chan)->amplitude, (size))
+#define mix_samples(out, src0, hires0, amp0, src1, hires1, amp1, size) \
+    mix_samples_hires((out), (src0), (hires0), (amp0), \
+                      (src1), (hires1), (amp1), (size))
+#else /* !HAVE_PCM_HIRES */
+#define mix_to_chan_size(chan, size) (size)
+#define chan_to_mix_size(chan, size) (size)
+#define write_samples(out, chan, size) \
+    write_samples((out), (chan)->start, (chan)->amplitude, (size))
+#define mix_samples(out, src0, hires0, amp0, src1, hires1, amp1, size) \
+    mix_samples((out), (src0), (amp0), (src1), (amp1), (size))
+#endif /* HAVE_PCM_HIRES */
+
 /** Private generic routines **/
 
 /* Mark channel active to mix its data */
@@ -158,6 +249,10 @@ fill_frame:
             {
                 chan->get_more(&chan->start, &chan->size);
                 ALIGN_AUDIOBUF(chan->start, chan->size);
+#ifdef HAVE_PCM_HIRES
+                if (chan->hires)
+                    chan->size &= ~(PCM_HIRES_SAMPLE_SIZE - 1);
+#endif
             }
 
             if (!(chan->start && chan->size))
@@ -174,8 +269,9 @@ fill_frame:
 
         /* Channel with least amount of data remaining determines the downmix
            size */
-        if (chan->size < mixsize)
-            mixsize = chan->size;
+        size_t chansize = chan_to_mix_size(chan, chan->size);
+        if (chansize < mixsize)
+            mixsize = chansize;
 
         chan_p++;
     }
@@ -189,40 +285,54 @@ fill_frame:
 
         if (LIKELY(!*chan_p))
         {
-            write_samples(mixptr, chan->start, chan->amplitude, mixsize);
+            write_samples(mixptr, chan, mixsize);
         }
         else
         {
             const void *src0, *src1;
             unsigned int amp0, amp1;
+#ifdef HAVE_PCM_HIRES
+            bool hires0, hires1;
+#endif
 
             /* Mix first two channels with each other as the downmix */
             src0 = chan->start;
             amp0 = chan->amplitude;
-            chan->last_size = mixsize;
+#ifdef HAVE_PCM_HIRES
+            hires0 = chan->hires;
+#endif
+            chan->last_size = mix_to_chan_size(chan, mixsize);
 
             chan = *chan_p++;
             src1 = chan->start;
             amp1 = chan->amplitude;
+#ifdef HAVE_PCM_HIRES
+            hires1 = chan->hires;
+#endif
 
             while (1)
             {
-                mix_samples(mixptr, src0, amp0, src1, amp1, mixsize);
+                mix_samples(mixptr, src0, hires0, amp0,
+                            src1, hires1, amp1, mixsize);
 
                 if (!*chan_p)
                     break;
 
                 /* More channels to mix - mix each with existing downmix */
-                chan->last_size = mixsize;
+                chan->last_size = mix_to_chan_size(chan, mixsize);
                 chan = *chan_p++;
                 src0 = mixptr;
                 amp0 = MIX_AMP_UNITY;
                 src1 = chan->start;
                 amp1 = chan->amplitude;
+#ifdef HAVE_PCM_HIRES
+                hires0 = true;
+                hires1 = chan->hires;
+#endif
             }
         }
 
-        chan->last_size = mixsize;
+        chan->last_size = mix_to_chan_size(chan, mixsize);
         next_size += mixsize;
 
         if (next_size < mix_frame_size)
@@ -245,8 +355,16 @@ fill_frame:
 
 #if FRAME_BOUNDARY_MARKERS != 0
     if (next_size)
+    {
+#ifdef HAVE_PCM_HIRES
+        int32_t marker = (1L << (PCM_HIRES_DEPTH - 1)) - (downmix_index ? 1 : 0);
+        downmix_buf[downmix_index][0] = downmix_index ? marker : -marker;
+        downmix_buf[downmix_index][1] = downmix_buf[downmix_index][0];
+#else
         *downmix_buf[downmix_index] = downmix_index ? 0x7fff7fff : 0x80008000;
 #endif
+    }
+#endif
 
     /* Certain SoC's have to do cleanup */
     mixer_buffer_callback_exit();
@@ -276,16 +394,20 @@ static void mixer_start_pcm(void)
 
     mixer_buffer_callback(PCM_DMAST_STARTED);
 
+#ifdef HAVE_PCM_HIRES
+    pcm_play_data_hires(mixer_pcm_callback, mixer_buffer_callback,
+                        start, mix_frame_size);
+#else
     pcm_play_data(mixer_pcm_callback, mixer_buffer_callback,
                   start, mix_frame_size);
+#endif
 }
 
-/** Public interfaces **/
-
-/* Start playback on a channel */
-void mixer_channel_play_data(enum pcm_mixer_channel channel,
-                             pcm_play_callback_type get_more,
-                             const void *start, size_t size)
+/* Start playback on a channel in either data format */
+static void mixer_channel_play_data_int(enum pcm_mixer_channel channel,
+                                        pcm_play_callback_type get_more,
+                                        const void *start, size_t size,
+                                        bool hires)
 {
     struct mixer_channel *chan = &channels[channel];
 
@@ -305,6 +427,11 @@ void mixer_channel_play_data(enum pcm_mixer_channel channel,
         ALIGN_AUDIOBUF(start, size);
     }
 
+#ifdef HAVE_PCM_HIRES
+    if (hires)
+        size &= ~(PCM_HIRES_SAMPLE_SIZE - 1);
+#endif
+
     pcm_play_lock();
 
     if (start && size)
@@ -315,6 +442,9 @@ void mixer_channel_play_data(enum pcm_mixer_channel channel,
         chan->size = size;
         chan->last_size = 0;
         chan->get_more = get_more;
+#ifdef HAVE_PCM_HIRES
+        chan->hires = hires;
+#endif
 
         mixer_activate_channel(chan);
         chan_call_buffer_hook(chan);
@@ -327,8 +457,29 @@ void mixer_channel_play_data(enum pcm_mixer_channel channel,
     }
 
     pcm_play_unlock();
+    (void)hires;
 }
 
+/** Public interfaces **/
+
+/* Start playback on a channel */
+void mixer_channel_play_data(enum pcm_mixer_channel channel,
+                             pcm_play_callback_type get_more,
+                             const void *start, size_t size)
+{
+    mixer_channel_play_data_int(channel, get_more, start, size, false);
+}
+
+#ifdef HAVE_PCM_HIRES
+/* Start playback on a channel with data in the high-resolution format */
+void mixer_channel_play_data_hires(enum pcm_mixer_channel channel,
+                                   pcm_play_callback_type get_more,
+                                   const void *start, size_t size)
+{
+    mixer_channel_play_data_int(channel, get_more, start, size, true);
+}
+#endif /* HAVE_PCM_HIRES */
+
 /* Pause or resume a channel (when started) */
 void mixer_channel_play_pause(enum pcm_mixer_channel channel, bool play)
 {
@@ -395,6 +546,13 @@ const void * mixer_channel_get_buffer(enum pcm_mixer_channel channel, int *count
     /* Still same buffer? */
     if (buf == buf2)
     {
+#ifdef HAVE_PCM_HIRES
+        if (chan->hires)
+        {
+            *count = size / PCM_HIRES_SAMPLE_SIZE;
+            return buf;
+        }
+#endif
         *count = size >> 2;
         return buf;
     }
@@ -411,6 +569,15 @@ void mixer_channel_calculate_peaks(enum pcm_mixer_channel channel,
     int count;
     const void *addr = mixer_channel_get_buffer(channel, &count);
 
+#ifdef HAVE_PCM_HIRES
+    if (channels[channel].hires)
+    {
+        pcm_do_peak_calculation_hires(peaks,
+                            channels[channel].status == CHANNEL_PLAYING,
+                            addr, count);
+        return;
+    }
+#endif
     pcm_do_peak_calculation(peaks,
                             channels[channel].status == CHANNEL_PLAYING,
                             addr, count);
@@ -470,7 +637,7 @@ void mixer_set_frequency(unsigned int samplerate)
     else
         mix_frame_size = 1;
 
-    mix_frame_size *= MIX_FRAME_SAMPLES * 4;
+    mix_frame_size *= MIX_FRAME_SAMPLES * MIX_SAMPLE_SIZE;
 }
 
 /* Get output samplerate */
@@ -344,17 +344,42 @@ static bool copy_frames(bool first)
 #endif
         }
 
-        /* Note:  This assumes stereo 16-bit */
-        if (pcm_size % 4)
+        /* Note:  This assumes stereo 16-bit, unless playing hi-res data */
+        size_t frame_size = 4;
+#ifdef HAVE_PCM_HIRES
+#ifdef HAVE_RECORDING
+        if (current_alsa_mode == SND_PCM_STREAM_PLAYBACK)
+#endif
+        if (pcm_play_depth > 16)
+            frame_size = PCM_HIRES_SAMPLE_SIZE;
+#endif
+        if (pcm_size % frame_size)
             panicf("Wrong pcm_size");
         /* the compiler will optimize this test away */
-        nframes = MIN((ssize_t)pcm_size/4, frames_left);
+        nframes = MIN((ssize_t)(pcm_size/frame_size), frames_left);
 
 #ifdef HAVE_RECORDING
         switch (current_alsa_mode)
         {
         case SND_PCM_STREAM_PLAYBACK:
 #endif
+#if defined(HAVE_PCM_HIRES)
+            if (frame_size == PCM_HIRES_SAMPLE_SIZE)
+            {
+                /* Same scaling as for 16-bit below, with the extra bits
+                   of resolution kept below the binary point */
+                const int32_t *pcm_ptr = pcm_data;
+                sample_t *sample_ptr = &frames[2*(period_size-frames_left)];
+                for (int i = 0; i < nframes; i++)
+                {
+                    *sample_ptr++ = ((int64_t)*pcm_ptr++ * dig_vol_mult_l
+                                        >> (PCM_HIRES_DEPTH - 16)) + PCM_DC_OFFSET_VALUE;
+                    *sample_ptr++ = ((int64_t)*pcm_ptr++ * dig_vol_mult_r
+                                        >> (PCM_HIRES_DEPTH - 16)) + PCM_DC_OFFSET_VALUE;
+                }
+            }
+            else
+#endif
 #if defined(HAVE_ALSA_32BIT)
             if (format == SND_PCM_FORMAT_S32_LE)
             {
@@ -383,8 +408,8 @@ static bool copy_frames(bool first)
             break;
         }
 #endif
-        pcm_data += nframes*4;
-        pcm_size -= nframes*4;
+        pcm_data += nframes*frame_size;
+        pcm_size -= nframes*frame_size;
         frames_left -= nframes;
 
         if (new_buffer && !first)
@@ -343,6 +343,13 @@ void sys_handle_argv(int argc, char *argv[])
                     debug_buttons = true;
                     printf("Printing background button clicks.\n");
             }
+#ifdef HAVE_SDL_THREADS
+            else if (!strcmp("--parallelcodec", argv[x]))
+            {
+                sim_parallel_codec = true;
+                printf("Running codecs outside the thread lock.\n");
+            }
+#endif
             else if (!strcmp("--audiodev", argv[x]))
             {
                 x++;
@@ -369,6 +376,9 @@ void sys_handle_argv(int argc, char *argv[])
                 printf("  --root [DIR]\t Set root directory\n");
                 printf("  --mapping \t Output coordinates and radius for mapping backgrounds\n");
                 printf("  --audiodev [NAME] \t Audio device name to use\n");
+#ifdef HAVE_SDL_THREADS
+                printf("  --parallelcodec \t Decode in parallel with the other threads\n");
+#endif
                 exit(0);
             }
         }
@@ -60,6 +60,8 @@ static SDL_mutex *m;
 #define THREADS_EXIT_COMMAND_DONE   2
 static volatile int threads_status = THREADS_RUN;
 
+bool sim_parallel_codec = false;
+
 extern long start_tick;
 
 void sim_thread_shutdown(void)
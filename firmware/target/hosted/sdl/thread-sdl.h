@@ -28,6 +28,9 @@ void sim_thread_lock(void *me);
 void * sim_thread_unlock(void);
 void sim_thread_exception_wait(void);
 void sim_thread_shutdown(void); /* Shut down all kernel threads gracefully */
+
+/* Let the codec run outside the lock, see apps/codecs.c */
+extern bool sim_parallel_codec;
 #endif
 
 #endif /* #ifndef __THREADSDL_H__ */
@@ -550,6 +550,11 @@ void usb_storage_transfer_complete(int ep,int dir,int status,int length)
                         cur_cmd.sector,
                         MIN(WRITE_BUFFER_SIZE/cur_cmd.block_size, cur_cmd.count),
                         cur_cmd.data[cur_cmd.data_select]);
+#ifdef HAVE_DISK_JOURNAL
+                    /* even a failed write may have changed something */
+                    disk_journal_write(IF_MD(cur_cmd.lun,) cur_cmd.sector,
+                        MIN(WRITE_BUFFER_SIZE/cur_cmd.block_size, cur_cmd.count));
+#endif
                 }
 
                 if(result != 0) {
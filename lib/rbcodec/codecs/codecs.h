@@ -285,6 +285,23 @@ int codec_load_buf(int hid, struct codec_api *api);
 int codec_load_file(const char* codec, struct codec_api *api);
 int codec_run_proc(void);
 int codec_close(void);
+#ifdef HAVE_CODEC_CACHE
+struct codec_cache_info
+{
+    size_t        size;       /* size of the cache area */
+    size_t        used;       /* bytes held by images */
+    unsigned int  count;      /* number of images held */
+    unsigned long hits;       /* loads copied from the cache */
+    unsigned long misses;     /* loads read from disk */
+    unsigned long evictions;  /* images dropped to make room */
+    long          hit_ticks;  /* time spent in loads from the cache */
+    long          miss_ticks; /* time spent in loads from disk */
+};
+
+void codec_cache_init(void *buf, size_t size);
+void codec_cache_get_info(struct codec_cache_info *info);
+const char * codec_cache_get_entry(unsigned int i, size_t *size);
+#endif /* HAVE_CODEC_CACHE */
 #if defined(HAVE_RECORDING)
 enc_callback_t codec_get_enc_callback(void);
 #endif
@@ -271,6 +271,266 @@ static void set_elapsed(struct mp3entry* id3)
     ci->set_elapsed(elapsed);
 }
 
+/* Exact seeking for streams without a usable TOC: the index holds the file
+ * position of every stride'th frame, recorded while decoding or while
+ * walking frame headers ahead of a seek, for as long as the number of the
+ * frame at hand is known. When it fills up every other entry is dropped
+ * and the stride doubles. It is kept across tracks so that replaying or
+ * resuming the same file seeks exactly right away. */
+#define SEEK_INDEX_SIZE 1024
+/* Bytes of frame headers we're willing to walk to extend the index ahead
+ * of a seek; anything further away is estimated as before */
+#define SEEK_SCAN_LIMIT (2*1024*1024)
+/* Frames decoded and discarded ahead of a seek target to refill the bit
+ * reservoir and the synthesis filter */
+#define SEEK_PREROLL    2
+
+static struct {
+    char path[MAX_PATH];
+    unsigned long filesize;
+    unsigned long frames;       /* number of frames covered */
+    unsigned long end_pos;      /* file position of frame 'frames' */
+    unsigned int spf;           /* samples per frame */
+    unsigned int stride;        /* frames between entries */
+    unsigned int count;         /* entries used */
+    uint32_t pos[SEEK_INDEX_SIZE];
+} seek_index;
+
+static long frame_num;          /* number of the next frame, -1 if unknown */
+static int preroll_frames;      /* frames left to discard after a seek */
+
+static const unsigned short mpa_bitrates[5][15] = {
+    { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+    { 0, 32, 48, 56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320, 384 },
+    { 0, 32, 40, 48,  56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320 },
+    { 0, 32, 48, 56,  64,  80,  96, 112, 128, 144, 160, 176, 192, 224, 256 },
+    { 0,  8, 16, 24,  32,  40,  48,  56,  64,  80,  96, 112, 128, 144, 160 },
+};
+
+static const unsigned short mpa_samplerates[3] = { 44100, 48000, 32000 };
+
+/* Return the size of the frame whose header is at p, or -1 if p doesn't
+ * point at a frame we can step over (including free format ones) */
+static int mpa_frame_size(const unsigned char *p, unsigned int *spf)
+{
+    unsigned long header = ((unsigned long)p[0] << 24) | (p[1] << 16) |
+                           (p[2] << 8) | p[3];
+    unsigned int version = (header >> 19) & 3; /* 3: 1, 2: 2, 0: 2.5 */
+    unsigned int layer   = 4 - ((header >> 17) & 3);
+    unsigned int bitrate = (header >> 12) & 15;
+    unsigned int srate   = (header >> 10) & 3;
+    unsigned int padding = (header >> 9) & 1;
+    unsigned long freq;
+    bool lsf = version != 3;
+
+    if ((header & 0xffe00000) != 0xffe00000 || version == 1 ||
+        layer == 4 || bitrate == 0 || bitrate == 15 || srate == 3)
+        return -1;
+
+    freq = mpa_samplerates[srate] >> (lsf ? (version == 2 ? 1 : 2) : 0);
+    if (lsf)
+        bitrate = mpa_bitrates[layer == 1 ? 3 : 4][bitrate];
+    else
+        bitrate = mpa_bitrates[layer - 1][bitrate];
+
+    if (layer == 1) {
+        *spf = 384;
+        return (12000 * bitrate / freq + padding) * 4;
+    }
+
+    *spf = (layer == 3 && lsf) ? 576 : 1152;
+    return (*spf / 8) * 1000 * bitrate / freq + padding;
+}
+
+static void seek_index_init(void)
+{
+    struct mp3entry *id3 = ci->id3;
+
+    if (id3->filesize == seek_index.filesize &&
+        !ci->strcmp(id3->path, seek_index.path))
+        return;
+
+    ci->strcpy(seek_index.path, id3->path);
+    seek_index.filesize = id3->filesize;
+    seek_index.frames = 0;
+    seek_index.end_pos = id3->first_frame_offset;
+    seek_index.spf = 0;
+    seek_index.stride = 1;
+    seek_index.count = 0;
+}
+
+/* Append the frame numbered seek_index.frames */
+static void seek_index_add(unsigned long pos, unsigned int size)
+{
+    if (seek_index.frames % seek_index.stride == 0) {
+        if (seek_index.count == SEEK_INDEX_SIZE) {
+            unsigned int i;
+            for (i = 0; i < SEEK_INDEX_SIZE / 2; i++)
+                seek_index.pos[i] = seek_index.pos[2*i];
+            seek_index.count = SEEK_INDEX_SIZE / 2;
+            seek_index.stride *= 2;
+        }
+
+        if (seek_index.frames % seek_index.stride == 0)
+            seek_index.pos[seek_index.count++] = pos;
+    }
+
+    seek_index.frames++;
+    seek_index.end_pos = pos + size;
+}
+
+/* Step over n frames starting at pos, optionally indexing them, and return
+ * the position reached or -1 if something other than a frame turns up */
+static long walk_frames(unsigned long pos, unsigned long n, bool add)
+{
+    while (n > 0) {
+        unsigned char *p;
+        size_t got, off = 0;
+
+        if (!ci->seek_buffer(pos))
+            return -1;
+
+        p = ci->request_buffer(&got, INPUT_CHUNK_SIZE);
+        if (p == NULL || got < 4)
+            return -1;
+
+        while (n > 0 && off + 4 <= got) {
+            unsigned int spf;
+            int size = mpa_frame_size(p + off, &spf);
+
+            if (size <= 0)
+                return -1;
+
+            if (add) {
+                seek_index.spf = spf;
+                seek_index_add(pos + off, size);
+            }
+
+            off += size;
+            n--;
+        }
+
+        pos += off;
+    }
+
+    return pos;
+}
+
+/* Note the frame the decoder has just parsed, extending the index if it's
+ * the next one we don't have yet */
+static void seek_index_frame(void)
+{
+    unsigned long pos;
+
+    if (frame_num < 0)
+        return;
+
+    pos = ci->curpos + (stream.this_frame - stream.buffer);
+
+    if ((unsigned long)frame_num == seek_index.frames) {
+        /* Junk between frames would throw off walk_frames() */
+        if (seek_index.frames > 0 && pos != seek_index.end_pos) {
+            frame_num = -1;
+            return;
+        }
+
+        seek_index.spf = 32 * MAD_NSBSAMPLES(&frame.header);
+        seek_index_add(pos, stream.next_frame - stream.this_frame);
+    }
+
+    frame_num++;
+}
+
+/* Position the stream a few frames ahead of sample 'target' and set up
+ * the skip that lands playback exactly on it */
+static bool seek_index_seek(uint64_t target, unsigned long freq,
+                            int64_t *samplesdone, int *samples_to_skip)
+{
+    unsigned long frame, start, entry;
+    off_t curpos = ci->curpos;
+    long pos;
+
+    if (ci->id3->is_asf_stream)
+        return false;
+
+    if (seek_index.frames == 0 && walk_frames(seek_index.end_pos, 1, true) < 0)
+        goto fail;
+
+    frame = target / seek_index.spf;
+    start = frame > SEEK_PREROLL ? frame - SEEK_PREROLL : 0;
+
+    if (start >= seek_index.frames) {
+        uint64_t avg = (seek_index.end_pos - seek_index.pos[0]) /
+                       seek_index.frames;
+
+        if ((start + 1 - seek_index.frames) * avg > SEEK_SCAN_LIMIT)
+            goto fail;
+
+        if (walk_frames(seek_index.end_pos, start + 1 - seek_index.frames,
+                        true) < 0)
+            goto fail;
+    }
+
+    entry = start / seek_index.stride;
+    pos = walk_frames(seek_index.pos[entry],
+                      start - entry * seek_index.stride, false);
+    if (pos < 0 || !ci->seek_buffer(pos))
+        goto fail;
+
+    frame_num = start;
+    preroll_frames = frame - start;
+
+    *samples_to_skip = target - (uint64_t)start * seek_index.spf +
+                       mpeg_latency[ci->id3->layer];
+    if (start == 0 && ci->id3->lead_trim >= 0 && ci->id3->tail_trim >= 0)
+        *samples_to_skip += ci->id3->lead_trim;
+
+    *samplesdone = target;
+    ci->set_elapsed(target * 1000 / freq);
+    return true;
+
+fail:
+    /* The estimating seek works relative to where we were */
+    ci->seek_buffer(curpos);
+    return false;
+}
+
+/* Resume at ci->id3->offset if it lies within the indexed part */
+static bool seek_index_resume(unsigned long freq, int64_t *samplesdone,
+                              int *samples_to_skip)
+{
+    unsigned long offset = ci->id3->offset;
+    unsigned long frame, pos;
+    unsigned int lo, hi;
+    long next;
+
+    if (ci->id3->is_asf_stream || seek_index.count == 0 ||
+        offset < seek_index.pos[0] || offset >= seek_index.end_pos)
+        return false;
+
+    /* Last entry at or before the offset */
+    lo = 0;
+    hi = seek_index.count;
+    while (hi - lo > 1) {
+        unsigned int mid = (lo + hi) / 2;
+        if (seek_index.pos[mid] <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    frame = lo * seek_index.stride;
+    pos = seek_index.pos[lo];
+    while ((next = walk_frames(pos, 1, false)) > 0 &&
+           (unsigned long)next <= offset) {
+        pos = next;
+        frame++;
+    }
+
+    return seek_index_seek((uint64_t)frame * seek_index.spf, freq,
+                           samplesdone, samples_to_skip);
+}
+
 #ifdef MPA_SYNTH_ON_COP
 
 /*
@@ -396,7 +656,8 @@ enum codec_status codec_main(enum codec_entry_call_reason reason)
     return CODEC_OK;
 }
 
-bool seek_by_time(int64_t* samplesdone, unsigned long current_frequency, unsigned long elapsed_ms)
+bool seek_by_time(int64_t* samplesdone, int *samples_to_skip,
+                  unsigned long current_frequency, unsigned long elapsed_ms)
 {
     if (ci->id3->is_asf_stream) {
         asf_waveformatex_t *wfx = (asf_waveformatex_t *)(ci->id3->toc);
@@ -413,9 +674,17 @@ bool seek_by_time(int64_t* samplesdone, unsigned long current_frequency, unsigne
             reset_stream_buffer();
         }
     } else {
+        preroll_frames = 0;
+
+        if (elapsed_ms && seek_index_seek((uint64_t)elapsed_ms * current_frequency / 1000,
+                                          current_frequency, samplesdone,
+                                          samples_to_skip))
+            return true;
+
         int newpos = elapsed_ms ? get_file_pos(elapsed_ms) : (int)(ci->id3->first_frame_offset);
 
         *samplesdone = ((int64_t)elapsed_ms) * current_frequency / 1000;
+        frame_num = elapsed_ms ? -1 : 0;
 
         if (!ci->seek_buffer(newpos))
             return false;
@@ -449,7 +718,22 @@ enum codec_status codec_run(void)
     current_frequency = ci->id3->frequency;
     codec_set_replaygain(ci->id3);
 
-     if (ci->id3->offset) {
+    if (ci->id3->lead_trim >= 0 && ci->id3->tail_trim >= 0) {
+        stop_skip = ci->id3->tail_trim - mpeg_latency[ci->id3->layer];
+        if (stop_skip < 0) stop_skip = 0;
+        start_skip = ci->id3->lead_trim + mpeg_latency[ci->id3->layer];
+    } else {
+        stop_skip = 0;
+        /* We want to skip this amount anyway */
+        start_skip = mpeg_latency[ci->id3->layer];
+    }
+
+    seek_index_init();
+    frame_num = -1;
+    preroll_frames = 0;
+    samples_to_skip = start_skip;
+
+    if (ci->id3->offset) {
 
         if (ci->id3->is_asf_stream) {
             asf_waveformatex_t *wfx = (asf_waveformatex_t *)(ci->id3->toc);
@@ -460,7 +744,8 @@ enum codec_status codec_run(void)
             ci->id3->elapsed = asf_get_timestamp(&packet_offset);
             ci->set_elapsed(ci->id3->elapsed);
         }
-        else {
+        else if (!seek_index_resume(current_frequency, &samplesdone,
+                                    &samples_to_skip)) {
             ci->seek_buffer(ci->id3->offset);
             if (ci->id3->elapsed && ci->id3->elapsed < ci->id3->length)
             {
@@ -474,18 +759,12 @@ enum codec_status codec_run(void)
     }
     else if (ci->id3->elapsed)
          /* Have elapsed time but not offset */
-        seek_by_time(&samplesdone, current_frequency, ci->id3->elapsed);
-    else
+        seek_by_time(&samplesdone, &samples_to_skip, current_frequency,
+                     ci->id3->elapsed);
+    else {
         ci->seek_buffer(ci->id3->first_frame_offset);
-
-    if (ci->id3->lead_trim >= 0 && ci->id3->tail_trim >= 0) {
-        stop_skip = ci->id3->tail_trim - mpeg_latency[ci->id3->layer];
-        if (stop_skip < 0) stop_skip = 0;
-        start_skip = ci->id3->lead_trim + mpeg_latency[ci->id3->layer];
-    } else {
-        stop_skip = 0;
-        /* We want to skip this amount anyway */
-        start_skip = mpeg_latency[ci->id3->layer];
+        if (!ci->id3->is_asf_stream)
+            frame_num = 0;
     }
 
     /* Libmad will not decode the last frame without 8 bytes of extra padding
@@ -500,13 +779,16 @@ enum codec_status codec_run(void)
         padding = MAD_BUFFER_GUARD;
     }
 
-    samplesdone = ((int64_t)ci->id3->elapsed) * current_frequency / 1000;
+    /* Unless the seek index placed us exactly, don't skip any samples
+       unless we start at the beginning. */
+    if (frame_num < 0) {
+        samplesdone = ((int64_t)ci->id3->elapsed) * current_frequency / 1000;
 
-    /* Don't skip any samples unless we start at the beginning. */
-    if (samplesdone > 0)
-        samples_to_skip = 0;
-    else
-        samples_to_skip = start_skip;
+        if (samplesdone > 0)
+            samples_to_skip = 0;
+        else
+            samples_to_skip = start_skip;
+    }
 
     if (ci->id3->is_asf_stream)
         reset_stream_buffer();
@@ -530,7 +812,8 @@ enum codec_status codec_run(void)
                 samples_to_skip = 0;
             }
 
-            bool success = seek_by_time(&samplesdone, current_frequency, param);
+            bool success = seek_by_time(&samplesdone, &samples_to_skip,
+                                        current_frequency, param);
             ci->seek_complete();
             if (!success)
                 break;
@@ -566,7 +849,17 @@ enum codec_status codec_run(void)
                 file_end++;
                 continue;
             } else if (MAD_RECOVERABLE(stream.error)) {
-                /* Probably syncing after a seek */
+                /* Probably syncing after a seek. If the header was fine the
+                   frame still counts, but it won't produce any samples. */
+                if ((stream.error & 0xff00) == 0x0200) {
+                    seek_index_frame();
+                    if (preroll_frames > 0) {
+                        preroll_frames--;
+                        samples_to_skip -= 32 * MAD_NSBSAMPLES(&frame.header);
+                        if (samples_to_skip < 0)
+                            samples_to_skip = 0;
+                    }
+                }
                 continue;
             } else {
                 /* Some other unrecoverable error */
@@ -574,6 +867,10 @@ enum codec_status codec_run(void)
             }
         }
 
+        seek_index_frame();
+        if (preroll_frames > 0)
+            preroll_frames--;
+
         /* Do the pcmbuf insert here. Note, this is the PREVIOUS frame's pcm
            data (not the one just decoded above). When we exit the decoding
            loop we will need to process the final frame that was decoded. */
@@ -25,6 +25,7 @@
 #include "fracmul.h"
 #include "dsp_proc_entry.h"
 #include "channel_mode.h"
+#include "dsp_simd.h"
 #include <string.h>
 
 #if 0
@@ -68,7 +69,8 @@ void channel_mode_proc_stereo(struct dsp_proc_entry *this,
 #endif
 
 #if !defined(CPU_COLDFIRE) && !defined(CPU_ARM)
-/* Unoptimized routines */
+/* Unoptimized routines; with DSP_HAVE_SIMD, whole vectors are done first
+ * and the C loop finishes the remainder */
 void channel_mode_proc_mono(struct dsp_proc_entry *this,
                             struct dsp_buffer **buf_p)
 {
@@ -77,13 +79,21 @@ void channel_mode_proc_mono(struct dsp_proc_entry *this,
     int32_t *sr = buf->p32[1];
     int count = buf->remcount;
 
-    do
+#ifdef DSP_HAVE_SIMD
+    for (; count >= 4; count -= 4, sl += 4, sr += 4)
+    {
+        dsp_v32 lr = v32_add(v32_half(v32_load(sl)), v32_half(v32_load(sr)));
+        v32_store(sl, lr);
+        v32_store(sr, lr);
+    }
+#endif
+
+    while (count-- > 0)
     {
         int32_t lr = *sl / 2 + *sr / 2;
         *sl++ = lr;
         *sr++ = lr;
     }
-    while (--count > 0);
 
     (void)this;
 }
@@ -101,14 +111,26 @@ void channel_mode_proc_custom(struct dsp_proc_entry *this,
     const int32_t gain  = data->sw_gain;
     const int32_t cross = data->sw_cross;
 
-    do
+#ifdef DSP_HAVE_SIMD
+    const dsp_v32 vgain  = v32_splat(gain);
+    const dsp_v32 vcross = v32_splat(cross);
+
+    for (; count >= 4; count -= 4, sl += 4, sr += 4)
+    {
+        dsp_v32 l = v32_load(sl);
+        dsp_v32 r = v32_load(sr);
+        v32_store(sl, v32_add(v32_fracmul(l, vgain), v32_fracmul(r, vcross)));
+        v32_store(sr, v32_add(v32_fracmul(r, vgain), v32_fracmul(l, vcross)));
+    }
+#endif
+
+    while (count-- > 0)
     {
         int32_t l = *sl;
         int32_t r = *sr;
         *sl++ = FRACMUL(l, gain) + FRACMUL(r, cross);
         *sr++ = FRACMUL(r, gain) + FRACMUL(l, cross);
     }
-    while (--count > 0);
 }
 
 void channel_mode_proc_karaoke(struct dsp_proc_entry *this,
@@ -119,13 +141,21 @@ void channel_mode_proc_karaoke(struct dsp_proc_entry *this,
     int32_t *sr = buf->p32[1];
     int count = buf->remcount;
 
-    do
+#ifdef DSP_HAVE_SIMD
+    for (; count >= 4; count -= 4, sl += 4, sr += 4)
+    {
+        dsp_v32 ch = v32_sub(v32_half(v32_load(sl)), v32_half(v32_load(sr)));
+        v32_store(sl, ch);
+        v32_store(sr, v32_neg(ch));
+    }
+#endif
+
+    while (count-- > 0)
     {
         int32_t ch = *sl / 2 - *sr / 2;
         *sl++ = ch;
         *sr++ = -ch;
     }
-    while (--count > 0);
 
     (void)this;
 }
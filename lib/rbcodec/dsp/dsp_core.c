@@ -42,6 +42,12 @@
 #define DSP_PROCESS_END()
 #endif /* !DSP_PROCESS_START */
 
+#ifndef DSP_PROC_CALL_START
+/* Bracket each stage's process call; used for per-stage profiling */
+#define DSP_PROC_CALL_START(id)
+#define DSP_PROC_CALL_END(id)
+#endif /* !DSP_PROC_CALL_START */
+
 /* Linked lists give fewer loads in processing loop compared to some index
  * list, which is more important than keeping occasionally executed code
  * simple */
@@ -385,7 +391,9 @@ static FORCE_INLINE void dsp_proc_call(struct dsp_proc_slot *s,
         buf->proc_mask |= s->mask;
     }
 
+    DSP_PROC_CALL_START(proc_db_entry(s)->id);
     s->proc_entry.process(&s->proc_entry, buf_p);
+    DSP_PROC_CALL_END(proc_db_entry(s)->id);
 }
 
 /**
@@ -412,7 +420,8 @@ static FORCE_INLINE void dsp_proc_call(struct dsp_proc_slot *s,
  *     remcount  = number of samples placed in buffer so far; set to
  *                 zero on first call
  *     p16out    = current fill pointer in destination buffer; set to
- *                 buffer start on first call
+ *                 buffer start on first call (p32out if the output
+ *                 depth was raised with dsp_set_output_depth())
  *     bufcount  = remaining buffer space in samples; set to maximum
  *                 desired output count on first call
  *     format    = ignored
@@ -477,7 +486,11 @@ void dsp_process(struct dsp_config *dsp, struct dsp_buffer *src,
 
         /* Advance buffers by what output consumed and produced */
         dsp_advance_buffer32(buf, outcount);
-        dsp_advance_buffer_output(dst, outcount);
+
+        if (dsp->io_data.output_depth > NATIVE_DEPTH)
+            dsp_advance_buffer_output32(dst, outcount);
+        else
+            dsp_advance_buffer_output(dst, outcount);
 
         DSP_PROCESS_LOOP();
     } /* while */
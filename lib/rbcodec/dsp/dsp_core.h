@@ -78,6 +78,7 @@ struct dsp_buffer
         const void *pin[2]; /* 04h: Channel pointers (In) */
         int32_t *p32[2];    /* 04h: Channel pointers (Int) */
         int16_t *p16out;    /* 04h: DSP output buffer (Out) */
+        int32_t *p32out;    /* 04h: DSP output buffer, > 16 bits (Out) */
     };
     union
     {
@@ -116,6 +117,16 @@ static inline void dsp_advance_buffer_output(struct dsp_buffer *buf,
     buf->p16out += 2 * by_count; /* Interleaved stereo */
 }
 
+/* As dsp_advance_buffer_output() for output depths above 16 bits, where
+   each sample occupies 32 bits. Provided to dsp_process() */
+static inline void dsp_advance_buffer_output32(struct dsp_buffer *buf,
+                                               int by_count)
+{
+    buf->bufcount -= by_count;
+    buf->remcount += by_count;
+    buf->p32out += 2 * by_count; /* Interleaved stereo */
+}
+
 /* Remove samples from internal input buffer (In, Int).
    Provided to dsp_process() or by another processing stage. */
 static inline void dsp_advance_buffer32(struct dsp_buffer *buf,
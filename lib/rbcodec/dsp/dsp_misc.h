@@ -26,6 +26,11 @@
 /* Set the tri-pdf dithered output */
 void dsp_dither_enable(bool enable); /* in dsp_sample_output.c */
 
+/* Set the audio DSP output sample depth; above 16 bits the output is
+   written as 32-bit words holding sign-extended samples. DSP_RESET
+   returns it to 16 bits. */
+void dsp_set_output_depth(unsigned int depth); /* in dsp_sample_output.c */
+
 enum replaygain_types
 {
     REPLAYGAIN_TRACK = 0,
@@ -37,5 +37,8 @@
 #ifdef HAVE_SW_TONE_CONTROLS
 #include "tone_controls.h"
 #endif
+#ifdef HAVE_RESAMPLE_SINC
+#include "resample.h"
+#endif
 
 #endif /* DSP_PROC_SETTINGS_H */
@@ -26,6 +26,7 @@
 #include "dsp_core.h"
 #include "dsp_sample_io.h"
 #include "dsp_proc_entry.h"
+#include "dsp_simd.h"
 
 #if 0
 #undef DEBUGF
@@ -96,11 +97,13 @@ static void sample_input_mono16(struct sample_io_data *this,
 
     dsp_advance_buffer_input(src, count, sizeof (int16_t));
 
-    do
-    {
+#ifdef DSP_HAVE_SIMD
+    for (; count >= 4; count -= 4, s += 4, d += 4)
+        v32_store(d, v32_load_s16(s, scale));
+#endif
+
+    while (count-- > 0)
         *d++ = *s++ << scale;
-    }
-    while (--count > 0);
 }
 
 /* convert count 16-bit interleaved stereo to 32-bit noninterleaved */
@@ -120,12 +123,21 @@ static void sample_input_i_stereo16(struct sample_io_data *this,
 
     dsp_advance_buffer_input(src, count, 2*sizeof (int16_t));
 
-    do
+#ifdef DSP_HAVE_SIMD
+    for (; count >= 4; count -= 4, s += 8, dl += 4, dr += 4)
+    {
+        dsp_v32 l, r;
+        v32_load2_s16(s, scale, &l, &r);
+        v32_store(dl, l);
+        v32_store(dr, r);
+    }
+#endif
+
+    while (count-- > 0)
     {
         *dl++ = *s++ << scale;
         *dr++ = *s++ << scale;
     }
-    while (--count > 0);
 }
 
 /* convert count 16-bit noninterleaved stereo to 32-bit noninterleaved */
@@ -146,12 +158,19 @@ static void sample_input_ni_stereo16(struct sample_io_data *this,
 
     dsp_advance_buffer_input(src, count, sizeof (int16_t));
 
-    do
+#ifdef DSP_HAVE_SIMD
+    for (; count >= 4; count -= 4, sl += 4, sr += 4, dl += 4, dr += 4)
+    {
+        v32_store(dl, v32_load_s16(sl, scale));
+        v32_store(dr, v32_load_s16(sr, scale));
+    }
+#endif
+
+    while (count-- > 0)
     {
         *dl++ = *sl++ << scale;
         *dr++ = *sr++ << scale;
     }
-    while (--count > 0);
 }
 
 /* convert count 32-bit mono to 32-bit mono */
@@ -188,12 +207,21 @@ static void sample_input_i_stereo32(struct sample_io_data *this,
 
     dsp_advance_buffer_input(src, count, 2*sizeof (int32_t));
 
-    do
+#ifdef DSP_HAVE_SIMD
+    for (; count >= 4; count -= 4, s += 8, dl += 4, dr += 4)
+    {
+        dsp_v32 l, r;
+        v32_load2(s, &l, &r);
+        v32_store(dl, l);
+        v32_store(dr, r);
+    }
+#endif
+
+    while (count-- > 0)
     {
         *dl++ = *s++;
         *dr++ = *s++;
     }
-    while (--count > 0);
 }
 
 /* convert 32 bit-noninterleaved stereo to 32-bit noninterleaved stereo */
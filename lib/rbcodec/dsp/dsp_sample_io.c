@@ -61,6 +61,7 @@ bool dsp_sample_io_configure(struct sample_io_data *this,
         this->format.codec_frequency = this->output_sampr;
         this->sample_depth = NATIVE_DEPTH;
         this->stereo_mode = STEREO_NONINTERLEAVED;
+        this->output_depth = NATIVE_DEPTH;
         break;
 
     case DSP_SET_FREQUENCY:
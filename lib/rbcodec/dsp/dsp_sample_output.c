@@ -25,6 +25,7 @@
 #include "dsp_sample_io.h"
 #include "dsp_proc_entry.h"
 #include "dsp-util.h"
+#include "dsp_simd.h"
 #include <string.h>
 
 #if 0
@@ -45,7 +46,8 @@ void sample_output_dithered(struct sample_io_data *this,
 /** Sample output **/
 
 #if !defined(CPU_COLDFIRE) && !defined(CPU_ARM)
-/* write mono internal format to output format */
+/* write mono internal format to output format; with DSP_HAVE_SIMD, whole
+   vectors are done first and the C loop finishes the remainder */
 void sample_output_mono(struct sample_io_data *this,
                         struct dsp_buffer *src, struct dsp_buffer *dst)
 {
@@ -55,13 +57,22 @@ void sample_output_mono(struct sample_io_data *this,
     int scale = src->format.output_scale;
     int32_t dc_bias = 1L << (scale - 1);
 
-    do
+#ifdef DSP_HAVE_SIMD
+    const dsp_v32 vbias = v32_splat(dc_bias);
+
+    for (; count >= 4; count -= 4, s0 += 4, d += 8)
+    {
+        dsp_v32 lr = v32_sra(v32_add(v32_load(s0), vbias), scale);
+        v32_store2_s16(d, lr, lr);
+    }
+#endif
+
+    while (count-- > 0)
     {
         int32_t lr = clip_sample_16((*s0++ + dc_bias) >> scale);
         *d++ = lr;
         *d++ = lr;
     }
-    while (--count > 0);
 }
 
 /* write stereo internal format to output format */
@@ -75,15 +86,46 @@ void sample_output_stereo(struct sample_io_data *this,
     int scale = src->format.output_scale;
     int32_t dc_bias = 1L << (scale - 1);
 
-    do
+#ifdef DSP_HAVE_SIMD
+    const dsp_v32 vbias = v32_splat(dc_bias);
+
+    for (; count >= 4; count -= 4, s0 += 4, s1 += 4, d += 8)
+    {
+        v32_store2_s16(d, v32_sra(v32_add(v32_load(s0), vbias), scale),
+                          v32_sra(v32_add(v32_load(s1), vbias), scale));
+    }
+#endif
+
+    while (count-- > 0)
     {
         *d++ = clip_sample_16((*s0++ + dc_bias) >> scale);
         *d++ = clip_sample_16((*s1++ + dc_bias) >> scale);
     }
-    while (--count > 0);
 }
 #endif /* CPU */
 
+/* write internal format to output format wider than 16 bits; samples are
+   sign-extended into 32-bit words. Dithering is pointless at these depths
+   since the DSP carries only a few more bits than are output. */
+static void sample_output_hires(struct sample_io_data *this,
+                                struct dsp_buffer *src, struct dsp_buffer *dst)
+{
+    int count = this->outcount;
+    const int32_t *s0 = src->p32[0];
+    const int32_t *s1 = src->p32[src->format.num_channels - 1];
+    int32_t *d = dst->p32out;
+    unsigned int depth = this->output_depth;
+    int scale = src->format.output_scale - (depth - NATIVE_DEPTH);
+    int32_t dc_bias = 1L << (scale - 1);
+
+    do
+    {
+        *d++ = clip_sample_depth((*s0++ + dc_bias) >> scale, depth);
+        *d++ = clip_sample_depth((*s1++ + dc_bias) >> scale, depth);
+    }
+    while (--count > 0);
+}
+
 /**
  * The "dither" code to convert the 24-bit samples produced by libmad was
  * taken from the coolplayer project - coolplayer.sourceforge.net
@@ -177,13 +219,18 @@ void dsp_sample_output_format_change(struct sample_io_data *this,
 
     DSP_PRINT_FORMAT(DSP Output, *format);
 
-    this->output_samples = fns[dither ? 1 : 0][channels - 1];
+    if (this->output_depth > NATIVE_DEPTH)
+        this->output_samples = sample_output_hires;
+    else
+        this->output_samples = fns[dither ? 1 : 0][channels - 1];
+
     this->output_version = format->version;
 }
 
 void dsp_sample_output_init(struct sample_io_data *this)
 {
     this->output_version = 0;
+    this->output_depth = NATIVE_DEPTH;
     this->output_samples = sample_output_stereo;
 }
 
@@ -211,3 +258,19 @@ void dsp_dither_enable(bool enable)
 
     data->output_version = 0; /* Force format update */
 }
+
+/* Set the output sample depth of the audio DSP */
+void dsp_set_output_depth(unsigned int depth)
+{
+    /* The internal format must keep at least one bit below the output
+       for rounding */
+    depth = MIN(MAX(depth, NATIVE_DEPTH), WORD_FRACBITS);
+
+    struct sample_io_data *data = (void *)dsp_get_config(CODEC_IDX_AUDIO);
+
+    if (depth == data->output_depth)
+        return;
+
+    data->output_depth = depth;
+    data->output_version = 0; /* Force format update */
+}
@@ -0,0 +1,185 @@
+/***************************************************************************
+ *             __________               __   ___.
+ *   Open      \______   \ ____   ____ |  | _\_ |__   _______  ___
+ *   Source     |       _//  _ \_/ ___\|  |/ /| __ \ /  _ \  \/  /
+ *   Jukebox    |    |   (  <_> )  \___|    < | \_\ (  <_> > <  <
+ *   Firmware   |____|_  /\____/ \___  >__|_ \|___  /\____/__/\_ \
+ *                     \/            \/     \/    \/            \/
+ * $Id$
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ****************************************************************************/
+#ifndef DSP_SIMD_H
+#define DSP_SIMD_H
+
+/* CPUs without hand-written DSP assembly (hosted x86 and aarch64 builds)
+ * run the data-parallel stages four samples at a time with NEON or SSE2,
+ * and the C reference loops finish the remainder. Results are bit-exact
+ * with the C code; "warble -t" checks this. Define DSP_NO_SIMD to build the
+ * C loops alone.
+ *
+ * All primitives work on four 32-bit lanes and use unaligned accesses.
+ */
+#if !defined(CPU_COLDFIRE) && !defined(CPU_ARM) && !defined(DSP_NO_SIMD) && \
+    (defined(__ARM_NEON) || defined(__SSE2__))
+#define DSP_HAVE_SIMD
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+
+typedef int32x4_t dsp_v32;
+
+static FORCE_INLINE dsp_v32 v32_load(const int32_t *p)
+    { return vld1q_s32(p); }
+
+static FORCE_INLINE void v32_store(int32_t *p, dsp_v32 v)
+    { vst1q_s32(p, v); }
+
+static FORCE_INLINE dsp_v32 v32_splat(int32_t x)
+    { return vdupq_n_s32(x); }
+
+static FORCE_INLINE dsp_v32 v32_add(dsp_v32 a, dsp_v32 b)
+    { return vaddq_s32(a, b); }
+
+static FORCE_INLINE dsp_v32 v32_sub(dsp_v32 a, dsp_v32 b)
+    { return vsubq_s32(a, b); }
+
+static FORCE_INLINE dsp_v32 v32_neg(dsp_v32 a)
+    { return vnegq_s32(a); }
+
+/* a >> n (arithmetic) */
+static FORCE_INLINE dsp_v32 v32_sra(dsp_v32 a, int n)
+    { return vshlq_s32(a, vdupq_n_s32(-n)); }
+
+/* a / 2, rounding toward zero as C division does */
+static FORCE_INLINE dsp_v32 v32_half(dsp_v32 a)
+{
+    uint32x4_t sign = vshrq_n_u32(vreinterpretq_u32_s32(a), 31);
+    return vshrq_n_s32(vaddq_s32(a, vreinterpretq_s32_u32(sign)), 1);
+}
+
+/* FRACMUL(a, b); b must not be INT32_MIN */
+static FORCE_INLINE dsp_v32 v32_fracmul(dsp_v32 a, dsp_v32 b)
+    { return vqdmulhq_s32(a, b); }
+
+/* 4 int16 -> int32 << n */
+static FORCE_INLINE dsp_v32 v32_load_s16(const int16_t *p, int n)
+    { return vshlq_s32(vmovl_s16(vld1_s16(p)), vdupq_n_s32(n)); }
+
+/* 4 interleaved int16 pairs -> int32 << n */
+static FORCE_INLINE void v32_load2_s16(const int16_t *p, int n,
+                                       dsp_v32 *a, dsp_v32 *b)
+{
+    int16x4x2_t v = vld2_s16(p);
+    *a = vshlq_s32(vmovl_s16(v.val[0]), vdupq_n_s32(n));
+    *b = vshlq_s32(vmovl_s16(v.val[1]), vdupq_n_s32(n));
+}
+
+/* 4 interleaved int32 pairs */
+static FORCE_INLINE void v32_load2(const int32_t *p, dsp_v32 *a, dsp_v32 *b)
+{
+    int32x4x2_t v = vld2q_s32(p);
+    *a = v.val[0];
+    *b = v.val[1];
+}
+
+/* interleave a and b, saturate to int16 and store 8 samples */
+static FORCE_INLINE void v32_store2_s16(int16_t *p, dsp_v32 a, dsp_v32 b)
+{
+    int16x4x2_t v = { { vqmovn_s32(a), vqmovn_s32(b) } };
+    vst2_s16(p, v);
+}
+
+#else /* __SSE2__ */
+#include <emmintrin.h>
+
+typedef __m128i dsp_v32;
+
+static FORCE_INLINE dsp_v32 v32_load(const int32_t *p)
+    { return _mm_loadu_si128((const __m128i *)p); }
+
+static FORCE_INLINE void v32_store(int32_t *p, dsp_v32 v)
+    { _mm_storeu_si128((__m128i *)p, v); }
+
+static FORCE_INLINE dsp_v32 v32_splat(int32_t x)
+    { return _mm_set1_epi32(x); }
+
+static FORCE_INLINE dsp_v32 v32_add(dsp_v32 a, dsp_v32 b)
+    { return _mm_add_epi32(a, b); }
+
+static FORCE_INLINE dsp_v32 v32_sub(dsp_v32 a, dsp_v32 b)
+    { return _mm_sub_epi32(a, b); }
+
+static FORCE_INLINE dsp_v32 v32_neg(dsp_v32 a)
+    { return _mm_sub_epi32(_mm_setzero_si128(), a); }
+
+/* a >> n (arithmetic) */
+static FORCE_INLINE dsp_v32 v32_sra(dsp_v32 a, int n)
+    { return _mm_sra_epi32(a, _mm_cvtsi32_si128(n)); }
+
+/* a / 2, rounding toward zero as C division does */
+static FORCE_INLINE dsp_v32 v32_half(dsp_v32 a)
+    { return _mm_srai_epi32(_mm_add_epi32(a, _mm_srli_epi32(a, 31)), 1); }
+
+/* FRACMUL(a, b)
+ * SSE2 only multiplies unsigned, so take bits 31..62 of the unsigned
+ * products and correct for the signs afterwards: the signed product is the
+ * unsigned one less ((a < 0 ? b : 0) + (b < 0 ? a : 0)) << 32. */
+static FORCE_INLINE dsp_v32 v32_fracmul(dsp_v32 a, dsp_v32 b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    __m128i lo   = _mm_set_epi32(0, -1, 0, -1);
+    __m128i r    = _mm_or_si128(_mm_and_si128(_mm_srli_epi64(even, 31), lo),
+                                _mm_andnot_si128(lo, _mm_slli_epi64(odd, 1)));
+    __m128i corr = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(a, 31), b),
+                                 _mm_and_si128(_mm_srai_epi32(b, 31), a));
+    return _mm_sub_epi32(r, _mm_slli_epi32(corr, 1));
+}
+
+/* 4 int16 -> int32 << n */
+static FORCE_INLINE dsp_v32 v32_load_s16(const int16_t *p, int n)
+{
+    __m128i v = _mm_loadl_epi64((const __m128i *)p);
+    v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    return _mm_sll_epi32(v, _mm_cvtsi32_si128(n));
+}
+
+/* 4 interleaved int16 pairs -> int32 << n */
+static FORCE_INLINE void v32_load2_s16(const int16_t *p, int n,
+                                       dsp_v32 *a, dsp_v32 *b)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i c = _mm_cvtsi32_si128(n);
+    *a = _mm_sll_epi32(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16), c);
+    *b = _mm_sll_epi32(_mm_srai_epi32(v, 16), c);
+}
+
+/* 4 interleaved int32 pairs */
+static FORCE_INLINE void v32_load2(const int32_t *p, dsp_v32 *a, dsp_v32 *b)
+{
+    __m128i v0 = _mm_shuffle_epi32(v32_load(p), _MM_SHUFFLE(3, 1, 2, 0));
+    __m128i v1 = _mm_shuffle_epi32(v32_load(p + 4), _MM_SHUFFLE(3, 1, 2, 0));
+    *a = _mm_unpacklo_epi64(v0, v1);
+    *b = _mm_unpackhi_epi64(v0, v1);
+}
+
+/* interleave a and b, saturate to int16 and store 8 samples */
+static FORCE_INLINE void v32_store2_s16(int16_t *p, dsp_v32 a, dsp_v32 b)
+{
+    __m128i v = _mm_packs_epi32(a, b);
+    v = _mm_unpacklo_epi16(v, _mm_srli_si128(v, 8));
+    _mm_storeu_si128((__m128i *)p, v);
+}
+
+#endif /* __ARM_NEON / __SSE2__ */
+#endif /* SIMD available */
+
+#endif /* DSP_SIMD_H */
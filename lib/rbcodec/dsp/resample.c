@@ -28,6 +28,13 @@
 #include "dsp_misc.h"
 #include "resample.h"
 #include <string.h>
+#ifdef HAVE_RESAMPLE_SINC
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE4_1__) && defined(__x86_64__)
+#include <smmintrin.h>
+#endif
+#endif /* HAVE_RESAMPLE_SINC */
 
 /**
  * Linear interpolation resampling that introduces a one sample delay because
@@ -39,7 +46,11 @@
 #define DEBUGF(...)
 #endif
 
+#ifdef HAVE_RESAMPLE_SINC
+#define RESAMPLE_BUF_COUNT 1024 /* Per channel, per DSP */
+#else
 #define RESAMPLE_BUF_COUNT 192 /* Per channel, per DSP */
+#endif
 
 /* CODEC_IDX_AUDIO = left and right, CODEC_IDX_VOICE = mono */
 static int32_t resample_out_bufs[3][RESAMPLE_BUF_COUNT] IBSS_ATTR;
@@ -56,16 +67,215 @@ static struct resample_data
     unsigned int frequency_out;     /* Resampler output samplerate */
     struct dsp_buffer resample_buf; /* Buffer descriptor for resampled data */
     int32_t *resample_out_p[2];     /* Actual output buffer pointers */
+#ifdef HAVE_RESAMPLE_SINC
+    bool sinc;                      /* Using the windowed-sinc resampler */
+#endif
 } resample_data[DSP_COUNT] IBSS_ATTR;
 
 /* Actual worker function. Implemented here or in target assembly code. */
 int resample_hermite(struct resample_data *data, struct dsp_buffer *src,
                      struct dsp_buffer *dst);
 
+#ifdef HAVE_RESAMPLE_SINC
+/**
+ * Polyphase windowed-sinc resampler, only ever used by the audio DSP.
+ *
+ * The Blackman-windowed sinc is tabulated at SINC_PHASES fractional offsets
+ * and each output sample blends the two nearest phases, so one table serves
+ * any ratio. The table depends only on the cutoff: all upsampling ratios
+ * share one and it is only rebuilt when a downsampling ratio changes.
+ */
+#define SINC_TAPS        64  /* FIR length, multiple of 4 */
+#define SINC_PHASE_BITS  7
+#define SINC_PHASES      (1 << SINC_PHASE_BITS)
+#define SINC_FRAC_BITS   (16 - SINC_PHASE_BITS) /* Phase blend fraction */
+#define SINC_COEF_BITS   30
+#define SINC_BLOCK       1024 /* Input samples taken per call */
+#define SINC_CUTOFF      59965 /* 0.915 in s15.16; band edge vs. Nyquist */
+
+static bool sinc_enabled = false;
+
+static struct sinc_state
+{
+    uint32_t cutoff;          /* Cutoff the table was built for, s15.16 */
+    /* Phase SINC_PHASES is included so blending needs no wraparound */
+    int32_t coefs[SINC_PHASES + 1][SINC_TAPS];
+    /* SINC_TAPS-1 history samples followed by the current input block */
+    int32_t buf[2][SINC_TAPS - 1 + SINC_BLOCK];
+} sinc_state;
+
+/* Build the table for a cutoff relative to the input Nyquist frequency */
+static void sinc_set_cutoff(uint32_t cutoff)
+{
+    struct sinc_state *st = &sinc_state;
+
+    if (st->cutoff == cutoff)
+        return;
+
+    st->cutoff = cutoff;
+
+    /* pi * cutoff in s15.16 */
+    int64_t pic = ((int64_t)205887 * cutoff) >> 16;
+
+    for (int p = 0; p <= SINC_PHASES; p++)
+    {
+        for (int j = 0; j < SINC_TAPS; j++)
+        {
+            /* Offset from the filter centre in 1/SINC_PHASES units */
+            int32_t xi = (j - (SINC_TAPS/2 - 1))*SINC_PHASES - p;
+            long c1, c2;
+            int64_t v;
+
+            if (xi == 0)
+            {
+                v = 1l << SINC_COEF_BITS;
+            }
+            else
+            {
+                /* sin(pi * cutoff * x) / (pi * cutoff * x) */
+                long sn = fp_sincos((uint32_t)(cutoff * xi) <<
+                                    (15 - SINC_PHASE_BITS), &c1);
+                v = ((int64_t)sn << (SINC_COEF_BITS + SINC_PHASE_BITS - 15))
+                        / (pic * xi);
+            }
+
+            /* Blackman window over +-SINC_TAPS/2 */
+            fp_sincos((uint32_t)xi << (31 - SINC_PHASE_BITS - 5), &c1);
+            fp_sincos((uint32_t)xi << (32 - SINC_PHASE_BITS - 5), &c2);
+            int64_t w = 450971566 + (c1 >> 2) +
+                        (((int64_t)c2 * 171798692) >> 32);
+
+            v = (v * w) >> SINC_COEF_BITS;
+            st->coefs[p][j] = (v * cutoff) >> 16;
+        }
+    }
+}
+
+/* Filter SINC_TAPS samples with two adjacent phases and blend the results */
+static inline int32_t sinc_filter(const int32_t *x, const int32_t *h,
+                                  uint32_t frac)
+{
+    const int32_t *h1 = h + SINC_TAPS;
+    int64_t acc0, acc1;
+
+#if defined(__ARM_NEON)
+    int64x2_t a0 = vdupq_n_s64(0), a1 = vdupq_n_s64(0);
+
+    for (int i = 0; i < SINC_TAPS; i += 4)
+    {
+        int32x4_t xv = vld1q_s32(x + i);
+        int32x4_t h0v = vld1q_s32(h + i);
+        int32x4_t h1v = vld1q_s32(h1 + i);
+        a0 = vmlal_s32(a0, vget_low_s32(xv), vget_low_s32(h0v));
+        a0 = vmlal_s32(a0, vget_high_s32(xv), vget_high_s32(h0v));
+        a1 = vmlal_s32(a1, vget_low_s32(xv), vget_low_s32(h1v));
+        a1 = vmlal_s32(a1, vget_high_s32(xv), vget_high_s32(h1v));
+    }
+
+    acc0 = vgetq_lane_s64(a0, 0) + vgetq_lane_s64(a0, 1);
+    acc1 = vgetq_lane_s64(a1, 0) + vgetq_lane_s64(a1, 1);
+#elif defined(__SSE4_1__) && defined(__x86_64__)
+    __m128i a0 = _mm_setzero_si128(), a1 = _mm_setzero_si128();
+
+    for (int i = 0; i < SINC_TAPS; i += 4)
+    {
+        /* _mm_mul_epi32 multiplies the even lanes; shift for the odd */
+        __m128i xv = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i xo = _mm_srli_epi64(xv, 32);
+        __m128i h0v = _mm_loadu_si128((const __m128i *)(h + i));
+        __m128i h1v = _mm_loadu_si128((const __m128i *)(h1 + i));
+        a0 = _mm_add_epi64(a0, _mm_mul_epi32(xv, h0v));
+        a0 = _mm_add_epi64(a0, _mm_mul_epi32(xo, _mm_srli_epi64(h0v, 32)));
+        a1 = _mm_add_epi64(a1, _mm_mul_epi32(xv, h1v));
+        a1 = _mm_add_epi64(a1, _mm_mul_epi32(xo, _mm_srli_epi64(h1v, 32)));
+    }
+
+    acc0 = _mm_cvtsi128_si64(a0) + _mm_extract_epi64(a0, 1);
+    acc1 = _mm_cvtsi128_si64(a1) + _mm_extract_epi64(a1, 1);
+#else
+    acc0 = acc1 = 0;
+
+    for (int i = 0; i < SINC_TAPS; i++)
+    {
+        acc0 += (int64_t)x[i] * h[i];
+        acc1 += (int64_t)x[i] * h1[i];
+    }
+#endif
+
+    int32_t y0 = acc0 >> SINC_COEF_BITS;
+    int32_t y1 = acc1 >> SINC_COEF_BITS;
+    return y0 + (int32_t)(((int64_t)(y1 - y0) * frac) >> SINC_FRAC_BITS);
+}
+
+/* Same contract as resample_hermite; output lags input by SINC_TAPS/2 */
+static int resample_sinc(struct resample_data *data, struct dsp_buffer *src,
+                         struct dsp_buffer *dst)
+{
+    int ch = src->format.num_channels - 1;
+    uint32_t count = MIN(src->remcount, SINC_BLOCK);
+    uint32_t delta = data->delta;
+    uint32_t phase, pos;
+    int32_t *d;
+
+    do
+    {
+        int32_t *buf = sinc_state.buf[ch];
+        memcpy(&buf[SINC_TAPS - 1], src->p32[ch], count*sizeof (int32_t));
+
+        d = dst->p32[ch];
+        int32_t *dmax = d + dst->bufcount;
+
+        /* Restore state */
+        phase = data->phase;
+        pos = phase >> 16;
+        pos = MIN(pos, count);
+
+        while (pos < count && d < dmax)
+        {
+            uint32_t frac = phase & 0xffff;
+            *d++ = sinc_filter(&buf[pos],
+                               sinc_state.coefs[frac >> SINC_FRAC_BITS],
+                               frac & ((1 << SINC_FRAC_BITS) - 1));
+            phase += delta;
+            pos = phase >> 16;
+        }
+
+        pos = MIN(pos, count);
+
+        /* Keep the samples preceding the first unconsumed one */
+        memmove(buf, &buf[pos], (SINC_TAPS - 1)*sizeof (int32_t));
+    }
+    while (--ch >= 0);
+
+    /* Wrap phase accumulator back to start of next frame. */
+    data->phase = phase - (pos << 16);
+
+    dst->remcount = d - dst->p32[0];
+    return pos;
+}
+
+/* Select the windowed-sinc resampler for the audio DSP */
+void dsp_resample_sinc_enable(bool enable)
+{
+    if (enable == sinc_enabled)
+        return;
+
+    sinc_enabled = enable;
+
+    /* Switch over once the current output has drained */
+    struct dsp_config *dsp = dsp_get_config(CODEC_IDX_AUDIO);
+    dsp_proc_want_format_update(dsp, DSP_PROC_RESAMPLE);
+}
+#endif /* HAVE_RESAMPLE_SINC */
+
 static void resample_flush_data(struct resample_data *data)
 {
     data->phase = 0;
     memset(&data->history, 0, sizeof (data->history));
+#ifdef HAVE_RESAMPLE_SINC
+    if (data->sinc)
+        memset(sinc_state.buf, 0, sizeof (sinc_state.buf));
+#endif
 }
 
 static void resample_flush(struct dsp_proc_entry *this)
@@ -94,6 +304,17 @@ static bool resample_new_delta(struct resample_data *data,
         return false;
     }
 
+#ifdef HAVE_RESAMPLE_SINC
+    if (data->sinc)
+    {
+        /* When downsampling, the band edge follows the output Nyquist */
+        uint32_t cutoff = SINC_CUTOFF;
+        if (frequency > fout)
+            cutoff = ((uint64_t)fp_div(fout, frequency, 16) * cutoff) >> 16;
+        sinc_set_cutoff(cutoff);
+    }
+#endif
+
     return true;
 }
 
@@ -212,7 +433,12 @@ static void resample_process(struct dsp_proc_entry *this,
     {
         dst->bufcount = RESAMPLE_BUF_COUNT;
 
+#ifdef HAVE_RESAMPLE_SINC
+        int consumed = data->sinc ? resample_sinc(data, src, dst) :
+                                    resample_hermite(data, src, dst);
+#else
         int consumed = resample_hermite(data, src, dst);
+#endif
 
         /* Advance src by consumed amount */
         if (consumed > 0)
@@ -241,6 +467,17 @@ static intptr_t resample_new_format(struct dsp_proc_entry *this,
     unsigned int fout = dsp_get_output_frequency(dsp);
     bool active = dsp_proc_active(dsp, DSP_PROC_RESAMPLE);
 
+#ifdef HAVE_RESAMPLE_SINC
+    bool sinc = sinc_enabled && dsp_get_id(dsp) == CODEC_IDX_AUDIO;
+    if (data->sinc != sinc)
+    {
+        /* Different history layout; start the new one clean */
+        data->sinc = sinc;
+        resample_flush_data(data);
+        frequency = 0; /* Force new settings */
+    }
+#endif
+
     if ((unsigned int)format->frequency != frequency ||
         data->frequency_out != fout)
     {
@@ -21,6 +21,13 @@
 #ifndef _DSP_RESAMPLE_H
 #define _DSP_RESAMPLE_H
 
+struct dsp_config;
+
 void dsp_resample_init(struct dsp_config *dsp, unsigned int dsp_id) INIT_ATTR;
 
+#ifdef HAVE_RESAMPLE_SINC
+/* Use the windowed-sinc resampler instead of cubic interpolation */
+void dsp_resample_sinc_enable(bool enable);
+#endif
+
 #endif /* _DSP_RESAMPLE_H */
@@ -454,6 +454,8 @@ bool get_metadata_ex(struct mp3entry* id3, int fd, const char* trackname, int fl
 
     entry = &audio_formats[id3->codectype];
 
+    bool attached = metadata_stream_attach(fd);
+
     /* Load codec specific track tag information and confirm the codec type. */
     if (!entry->parse_func)
     {
@@ -469,6 +471,9 @@ bool get_metadata_ex(struct mp3entry* id3, int fd, const char* trackname, int fl
         wipe_mp3entry(id3); /* ensure the mp3entry is clear */
     }
 
+    if (attached)
+        metadata_stream_detach(fd);
+
     if ((flags & METADATA_CLOSE_FD_ON_EXIT))
         close(fd);
     else
@@ -20,6 +20,7 @@
  ****************************************************************************/
 #include <inttypes.h>
 #include "metadata.h"
+#include "metadata_stream.h"
 
 #ifdef ROCKBOX_BIG_ENDIAN
 #define IS_BIG_ENDIAN 1
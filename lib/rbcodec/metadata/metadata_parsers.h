@@ -19,6 +19,8 @@
  *
  ****************************************************************************/
 
+#include "metadata_stream.h"
+
 char* id3_get_num_genre(unsigned int genre_num);
 int getid3v1len(int fd);
 int getid3v2len(int fd);
@@ -0,0 +1,192 @@
+/***************************************************************************
+ *             __________               __   ___.
+ *   Open      \______   \ ____   ____ |  | _\_ |__   _______  ___
+ *   Source     |       _//  _ \_/ ___\|  |/ /| __ \ /  _ \  \/  /
+ *   Jukebox    |    |   (  <_> )  \___|    < | \_\ (  <_> > <  <
+ *   Firmware   |____|_  /\____/ \___  >__|_ \|___  /\____/__/\_ \
+ *                     \/            \/     \/    \/            \/
+ * $Id$
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ****************************************************************************/
+#include <string.h>
+#include <stdbool.h>
+#include "platform.h"
+#define METADATA_STREAM_NO_REDIRECT
+#include "metadata_stream.h"
+
+/* get_metadata_ex() may run in the playback and the tagcache threads at
+ * the same time */
+#define METADATA_STREAMS 2
+
+static struct metadata_stream
+{
+    int fd;         /* attached file or -1 */
+    off_t pos;      /* position seen by the parser */
+    off_t fs_pos;   /* position of the file itself */
+    off_t start;    /* file offset of buf[0] */
+    size_t len;     /* valid bytes in buf */
+    unsigned char buf[METADATA_STREAM_BUFSIZE];
+} streams[METADATA_STREAMS] =
+{
+    [0 ... METADATA_STREAMS-1] = { .fd = -1 },
+};
+
+static unsigned long fs_reads;
+
+static struct metadata_stream *find_stream(int fd)
+{
+    for (int i = 0; i < METADATA_STREAMS; i++)
+    {
+        if (streams[i].fd == fd)
+            return &streams[i];
+    }
+    return NULL;
+}
+
+bool metadata_stream_attach(int fd)
+{
+    struct metadata_stream *s;
+
+    if (fd < 0 || find_stream(fd) || !(s = find_stream(-1)))
+        return false;
+
+    /* Claim the slot before lseek() can yield to another thread */
+    s->fd = fd;
+
+    off_t pos = lseek(fd, 0, SEEK_CUR);
+    if (pos < 0)
+    {
+        s->fd = -1;
+        return false;
+    }
+
+    s->pos = s->fs_pos = s->start = pos;
+    s->len = 0;
+    return true;
+}
+
+void metadata_stream_detach(int fd)
+{
+    struct metadata_stream *s = find_stream(fd);
+    if (!s)
+        return;
+
+    /* leave the file where the parser thinks it is */
+    if (s->fs_pos != s->pos)
+        lseek(fd, s->pos, SEEK_SET);
+    s->fd = -1;
+}
+
+static ssize_t fs_read(struct metadata_stream *s, void *buf, size_t count)
+{
+    if (s->fs_pos != s->pos)
+    {
+        if (lseek(s->fd, s->pos, SEEK_SET) < 0)
+            return -1;
+        s->fs_pos = s->pos;
+    }
+
+    ssize_t rc = read(s->fd, buf, count);
+    fs_reads++;
+    if (rc > 0)
+        s->fs_pos += rc;
+    return rc;
+}
+
+ssize_t metadata_stream_read(int fd, void *buf, size_t count)
+{
+    struct metadata_stream *s = find_stream(fd);
+    unsigned char *p = buf;
+    ssize_t total = 0;
+
+    if (!s)
+        return read(fd, buf, count);
+
+    while (count > 0)
+    {
+        if (s->pos >= s->start && s->pos < s->start + (off_t)s->len)
+        {
+            size_t offs = s->pos - s->start;
+            size_t n = MIN(count, s->len - offs);
+            memcpy(p, s->buf + offs, n);
+            p += n;
+            s->pos += n;
+            total += n;
+            count -= n;
+            continue;
+        }
+
+        ssize_t rc;
+        if (count >= sizeof(s->buf))
+        {
+            /* large reads (tag frames, album art) bypass the buffer */
+            rc = fs_read(s, p, count);
+            if (rc > 0)
+            {
+                p += rc;
+                s->pos += rc;
+                total += rc;
+                count -= rc;
+            }
+        }
+        else
+        {
+            s->start = s->pos;
+            s->len = 0;
+            rc = fs_read(s, s->buf, sizeof(s->buf));
+            if (rc > 0)
+                s->len = rc;
+        }
+
+        if (rc <= 0)
+            return total > 0 ? total : rc;
+    }
+
+    return total;
+}
+
+off_t metadata_stream_lseek(int fd, off_t offset, int whence)
+{
+    struct metadata_stream *s = find_stream(fd);
+    off_t pos;
+
+    if (!s)
+        return lseek(fd, offset, whence);
+
+    switch (whence)
+    {
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = s->pos + offset;
+        break;
+    default:
+        /* the end isn't known here, let the filesystem work it out */
+        pos = lseek(fd, offset, whence);
+        if (pos < 0)
+            return pos;
+        s->fs_pos = pos;
+        break;
+    }
+
+    if (pos < 0)
+        return -1;
+
+    /* the actual seek is done on the next read that misses the buffer */
+    s->pos = pos;
+    return pos;
+}
+
+unsigned long metadata_stream_fs_reads(void)
+{
+    return fs_reads;
+}
@@ -0,0 +1,61 @@
+/***************************************************************************
+ *             __________               __   ___.
+ *   Open      \______   \ ____   ____ |  | _\_ |__   _______  ___
+ *   Source     |       _//  _ \_/ ___\|  |/ /| __ \ /  _ \  \/  /
+ *   Jukebox    |    |   (  <_> )  \___|    < | \_\ (  <_> > <  <
+ *   Firmware   |____|_  /\____/ \___  >__|_ \|___  /\____/__/\_ \
+ *                     \/            \/     \/    \/            \/
+ * $Id$
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ****************************************************************************/
+#ifndef _METADATA_STREAM_H_
+#define _METADATA_STREAM_H_
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* The parsers read headers and tags a few bytes at a time (down to single
+ * bytes when hunting for mp3 frame sync). While get_metadata_ex() runs the
+ * file is attached to a read buffer and the parsers' read() and lseek()
+ * calls are served from it, so the filesystem only sees block sized reads.
+ * Reads on files that aren't attached go straight to the filesystem. */
+#ifndef METADATA_STREAM_BUFSIZE
+#ifdef __PCTOOL__
+#define METADATA_STREAM_BUFSIZE (32*1024)
+#elif defined(MEMORYSIZE) && MEMORYSIZE <= 2
+#define METADATA_STREAM_BUFSIZE 512
+#else
+#define METADATA_STREAM_BUFSIZE 1024
+#endif
+#endif
+
+/* Attach fd, returns false if all buffers are in use (reads then simply
+ * aren't buffered) */
+bool metadata_stream_attach(int fd);
+void metadata_stream_detach(int fd);
+
+ssize_t metadata_stream_read(int fd, void *buf, size_t count);
+off_t metadata_stream_lseek(int fd, off_t offset, int whence);
+
+/* Number of reads that reached the filesystem */
+unsigned long metadata_stream_fs_reads(void);
+
+/* Everything after the platform file functions goes through the stream.
+ * Only the core parsers get this; plugins and codecs can't reach the
+ * stream functions. */
+#if !defined(METADATA_STREAM_NO_REDIRECT) && !defined(PLUGIN) && !defined(CODEC)
+#undef read
+#define read(fd, buf, count)      metadata_stream_read((fd), (buf), (count))
+#undef lseek
+#define lseek(fd, offset, whence) metadata_stream_lseek((fd), (offset), (whence))
+#endif
+
+#endif /* _METADATA_STREAM_H_ */
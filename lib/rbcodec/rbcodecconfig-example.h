@@ -3,6 +3,7 @@
 
 #define HAVE_PITCHCONTROL
 #define HAVE_SW_TONE_CONTROLS
+#define HAVE_RESAMPLE_SINC
 #define HAVE_ALBUMART
 #define NUM_CORES 1
 /* All the same unless a configuration option is added to warble */
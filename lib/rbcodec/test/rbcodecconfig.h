@@ -1,2 +1,14 @@
 #include "../rbcodecconfig-example.h"
 #include "system.h"
+
+#ifndef __ASSEMBLER__
+/* Per-stage DSP timing for warble's benchmark mode */
+uint64_t warble_stage_start(void);
+void warble_stage_end(unsigned int id, uint64_t start);
+
+#define DSP_PROC_CALL_START(id) \
+    uint64_t warble_stage_t0_ = warble_stage_start()
+
+#define DSP_PROC_CALL_END(id) \
+    warble_stage_end((id), warble_stage_t0_)
+#endif
@@ -30,12 +30,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #include "buffering.h" /* TYPE_PACKET_AUDIO */
 #include "kernel.h"
 #include "core_alloc.h"
 #include "codecs.h"
 #include "dsp_core.h"
+#include "dsp_proc_entry.h"
+#include "resample.h"
+#include "eq.h"
+#include "crossfeed.h"
+#include "compressor.h"
+#include "channel_mode.h"
 #include "metadata.h"
 #include "settings.h"
 #include "sound.h"
@@ -97,10 +104,11 @@ off_t filesize(int fd)
 
 /***************** INTERNAL *****************/
 
-static enum { MODE_PLAY, MODE_WRITE } mode;
+static enum { MODE_PLAY, MODE_WRITE, MODE_BENCH, MODE_CHECK } mode;
 static bool use_dsp = true;
 static bool enable_loop = false;
 static const char *config = "";
+static const char *config_arg = "";
 
 /* Volume control */
 #define VOL_FRACBITS 31
@@ -379,11 +387,320 @@ static void playback_pcm(int16_t *pcm, int count)
     }
 }
 
+/***** MODE_BENCH *****/
+
+/* MODE_BENCH decodes each input with the output discarded, timing the codec,
+ * each ci_pcmbuf_insert call and each DSP stage, and prints one JSON object
+ * per file on stdout. */
+
+#define DSP_PROC_DB_START static const char * const bench_stage_names[] = {
+#define DSP_PROC_DB_ITEM(name) [DSP_PROC_##name] = #name,
+#define DSP_PROC_DB_STOP };
+#include "dsp_proc_database.h"
+#define BENCH_NUM_STAGES ARRAYLEN(bench_stage_names)
+
+static uint64_t bench_stage_ns[BENCH_NUM_STAGES];
+static unsigned long bench_stage_calls[BENCH_NUM_STAGES];
+static uint64_t *bench_insert_ns;
+static size_t bench_insert_count, bench_insert_alloc;
+static uint64_t bench_dsp_ns;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+uint64_t warble_stage_start(void)
+{
+    return mode == MODE_BENCH ? now_ns() : 0;
+}
+
+void warble_stage_end(unsigned int id, uint64_t start)
+{
+    if (mode != MODE_BENCH || id >= BENCH_NUM_STAGES)
+        return;
+    bench_stage_ns[id] += now_ns() - start;
+    bench_stage_calls[id]++;
+}
+
+static void bench_init(void)
+{
+    mode = MODE_BENCH;
+}
+
+static void bench_reset(void)
+{
+    memset(bench_stage_ns, 0, sizeof(bench_stage_ns));
+    memset(bench_stage_calls, 0, sizeof(bench_stage_calls));
+    bench_insert_count = 0;
+    bench_dsp_ns = 0;
+}
+
+static void bench_record_insert(uint64_t ns)
+{
+    if (bench_insert_count == bench_insert_alloc) {
+        bench_insert_alloc = bench_insert_alloc ? bench_insert_alloc * 2 : 4096;
+        bench_insert_ns = realloc(bench_insert_ns,
+                                  bench_insert_alloc * sizeof(uint64_t));
+        if (!bench_insert_ns) {
+            fprintf(stderr, "error: out of memory\n");
+            exit(1);
+        }
+    }
+    bench_insert_ns[bench_insert_count++] = ns;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Nearest-rank percentile of the sorted insert timings */
+static uint64_t bench_percentile(int pct)
+{
+    if (bench_insert_count == 0)
+        return 0;
+    size_t rank = (bench_insert_count * pct + 99) / 100;
+    return bench_insert_ns[rank ? rank - 1 : 0];
+}
+
+static void bench_print_string(const char *str)
+{
+    putchar('"');
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\')
+            printf("\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            printf("\\u%04x", *str);
+        else
+            putchar(*str);
+    }
+    putchar('"');
+}
+
+static void bench_report(const char *input_fn, unsigned long freq,
+                         uint64_t decode_ns)
+{
+    double decode_s = decode_ns / 1e9;
+    double audio_s = freq ? (double)num_output_samples / freq : 0;
+    uint64_t insert_total = 0;
+    size_t i;
+
+    for (i = 0; i < bench_insert_count; i++)
+        insert_total += bench_insert_ns[i];
+    qsort(bench_insert_ns, bench_insert_count, sizeof(uint64_t), compare_u64);
+
+    printf("{\"file\":");
+    bench_print_string(input_fn);
+    printf(",\"frequency\":%lu,\"samples\":%lu,\"audio_s\":%.6f"
+           ",\"decode_s\":%.6f,\"realtime\":%.3f,\"samples_per_s\":%.0f",
+           freq, num_output_samples, audio_s, decode_s,
+           decode_s > 0 ? audio_s / decode_s : 0,
+           decode_s > 0 ? num_output_samples / decode_s : 0);
+    printf(",\"insert\":{\"calls\":%zu,\"mean_ns\":%llu,\"p50_ns\":%llu"
+           ",\"p90_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}",
+           bench_insert_count,
+           (unsigned long long)(bench_insert_count ?
+                                insert_total / bench_insert_count : 0),
+           (unsigned long long)bench_percentile(50),
+           (unsigned long long)bench_percentile(90),
+           (unsigned long long)bench_percentile(99),
+           (unsigned long long)bench_percentile(100));
+    printf(",\"dsp_ns\":%llu,\"stages\":{", (unsigned long long)bench_dsp_ns);
+    bool first = true;
+    for (i = 0; i < BENCH_NUM_STAGES; i++) {
+        if (!bench_stage_calls[i])
+            continue;
+        printf("%s\"%s\":{\"calls\":%lu,\"ns\":%llu}", first ? "" : ",",
+               bench_stage_names[i], bench_stage_calls[i],
+               (unsigned long long)bench_stage_ns[i]);
+        first = false;
+    }
+    printf("}}\n");
+    fflush(stdout);
+}
+
+/***** MODE_CHECK *****/
+
+/* The vectorized DSP stages do whole vectors and leave the remainder to the
+ * C loops, which are all a DSP_NO_SIMD build runs. Feeding the same input
+ * through the DSP in one go and then one sample at a time compares the two
+ * for sample input, channel modes and sample output. */
+#define CHECK_SAMPLES 1027
+
+static const struct check_input {
+    const char *name;
+    int stereo_mode;
+    int depth;
+} check_inputs[] = {
+    { "mono16",      STEREO_MONO,           16 },
+    { "i_stereo16",  STEREO_INTERLEAVED,    16 },
+    { "ni_stereo16", STEREO_NONINTERLEAVED, 16 },
+    { "i_stereo32",  STEREO_INTERLEAVED,    17 }, /* low bits reach output */
+};
+
+static const struct check_chan {
+    const char *name;
+    int mode;
+    int width;
+} check_chans[] = {
+    { "stereo",  SOUND_CHAN_STEREO,  100 },
+    { "mono",    SOUND_CHAN_MONO,    100 },
+    { "narrow",  SOUND_CHAN_CUSTOM,   40 },
+    { "wide",    SOUND_CHAN_CUSTOM,  250 },
+    { "karaoke", SOUND_CHAN_KARAOKE, 100 },
+};
+
+static int32_t check_in32[2][2 * CHECK_SAMPLES];
+static int16_t check_in16[2][2 * CHECK_SAMPLES];
+
+static void check_fill_input(void)
+{
+    uint32_t seed = 0x12345678;
+
+    for (int ch = 0; ch < 2; ch++) {
+        for (int i = 0; i < 2 * CHECK_SAMPLES; i++) {
+            seed = seed * 1664525 + 1013904223;
+            /* Full range for 16-bit input; 17-bit input goes one bit
+               over full scale so that output clipping is exercised */
+            check_in16[ch][i] = seed >> 16;
+            check_in32[ch][i] = (int32_t)seed >> 13;
+        }
+
+        /* Extremes at the start where they land in a vector */
+        check_in16[ch][0] = INT16_MIN;
+        check_in16[ch][1] = INT16_MAX;
+        check_in32[ch][0] = -(1 << 18);
+        check_in32[ch][1] = (1 << 18) - 1;
+    }
+}
+
+/* Run the whole input through the DSP, step samples per call */
+static int check_run(const struct check_input *in, int step, int16_t *out)
+{
+    struct dsp_config *dsp = dsp_get_config(CODEC_IDX_AUDIO);
+    dsp_configure(dsp, DSP_RESET, 0);
+    dsp_configure(dsp, DSP_FLUSH, 0);
+    dsp_configure(dsp, DSP_SET_SAMPLE_DEPTH, in->depth);
+    dsp_configure(dsp, DSP_SET_STEREO_MODE, in->stereo_mode);
+
+    size_t size = in->depth > 16 ? sizeof(int32_t) : sizeof(int16_t);
+    const char *ch1 = in->depth > 16 ? (void *)check_in32[0] : (void *)check_in16[0];
+    const char *ch2 = in->depth > 16 ? (void *)check_in32[1] : (void *)check_in16[1];
+    if (in->stereo_mode == STEREO_INTERLEAVED)
+        size *= 2;
+
+    struct dsp_buffer dst;
+    dst.remcount = 0;
+    dst.p16out = out;
+    dst.bufcount = CHECK_SAMPLES;
+
+    for (int pos = 0; pos < CHECK_SAMPLES; pos += step) {
+        struct dsp_buffer src;
+        src.remcount = MIN(step, CHECK_SAMPLES - pos);
+        src.pin[0] = ch1 + pos * size;
+        src.pin[1] = ch2 + pos * size;
+        src.proc_mask = 0;
+
+        while (src.remcount > 0 && dst.bufcount > 0)
+            dsp_process(dsp, &src, &dst);
+    }
+
+    return dst.remcount;
+}
+
+static int self_check(void)
+{
+    static int16_t out_vec[2 * CHECK_SAMPLES], out_ref[2 * CHECK_SAMPLES];
+    int failures = 0;
+
+    memset(&global_settings, 0, sizeof(global_settings));
+    dsp_init();
+    dsp_configure(dsp_get_config(CODEC_IDX_AUDIO), DSP_SET_OUT_FREQUENCY,
+                  DSP_OUT_DEFAULT_HZ);
+    dsp_dither_enable(false);
+    check_fill_input();
+
+    for (size_t c = 0; c < ARRAYLEN(check_chans); c++) {
+        channel_mode_set_config(check_chans[c].mode);
+        channel_mode_custom_set_width(check_chans[c].width);
+
+        for (size_t i = 0; i < ARRAYLEN(check_inputs); i++) {
+            const struct check_input *in = &check_inputs[i];
+
+            memset(out_vec, 0, sizeof(out_vec));
+            memset(out_ref, 0x55, sizeof(out_ref));
+            int n_vec = check_run(in, CHECK_SAMPLES, out_vec);
+            int n_ref = check_run(in, 1, out_ref);
+
+            int bad = -1;
+            if (n_vec != CHECK_SAMPLES || n_ref != CHECK_SAMPLES) {
+                bad = MIN(n_vec, n_ref);
+            } else {
+                for (int k = 0; k < 2 * CHECK_SAMPLES; k++) {
+                    if (out_vec[k] != out_ref[k]) {
+                        bad = k / 2;
+                        break;
+                    }
+                }
+            }
+
+            if (bad >= 0) {
+                printf("%-11s %-8s FAILED at sample %d\n",
+                       in->name, check_chans[c].name, bad);
+                failures++;
+            } else {
+                printf("%-11s %-8s ok\n", in->name, check_chans[c].name);
+            }
+        }
+    }
+
+    channel_mode_set_config(SOUND_CHAN_STEREO);
+    return failures;
+}
+
 /***** ALL MODES *****/
 
+/* Set every equalizer band to the same gain, in tenths of a dB; 0 turns the
+ * equalizer off */
+static void set_eq_gain(int gain)
+{
+    static const struct eq_band_setting bands[EQ_NUM_BANDS] = {
+        { 32, 7, 0 }, { 64, 10, 0 }, { 125, 10, 0 }, { 250, 10, 0 },
+        { 500, 10, 0 }, { 1000, 10, 0 }, { 2000, 10, 0 }, { 4000, 10, 0 },
+        { 8000, 10, 0 }, { 16000, 7, 0 },
+    };
+
+    dsp_eq_enable(gain != 0);
+    dsp_set_eq_precut(gain > 0 ? gain : 0);
+
+    for (int i = 0; i < EQ_NUM_BANDS; i++) {
+        struct eq_band_setting band = bands[i];
+        band.gain = gain;
+        dsp_set_eq_coefs(i, &band);
+    }
+}
+
+/* Compress above threshold (negative dB); 0 turns the compressor off */
+static void set_compressor(int threshold)
+{
+    struct compressor_settings settings = {
+        .threshold    = threshold,
+        .makeup_gain  = 1,   /* auto */
+        .ratio        = 1,   /* 4:1 */
+        .knee         = 1,   /* soft */
+        .release_time = 500,
+        .attack_time  = 5,
+    };
+
+    dsp_set_compressor(&settings);
+}
+
 static void perform_config(void)
 {
-    /* TODO: equalizer, etc. */
     while (config) {
         const char *name = config;
         const char *eq = strchr(config, '=');
@@ -395,8 +712,14 @@ static void perform_config(void)
         if (!strncmp(name, "wait=", 5)) {
             if (atoi(val) > num_output_samples)
                 return;
+        } else if (!strncmp(name, "compressor=", 11)) {
+            set_compressor(atoi(val));
+        } else if (!strncmp(name, "crossfeed=", 10)) {
+            dsp_set_crossfeed_type(atoi(val));
         } else if (!strncmp(name, "dither=", 7)) {
             dsp_dither_enable(atoi(val) ? true : false);
+        } else if (!strncmp(name, "eq=", 3)) {
+            set_eq_gain(atof(val) * 10);
         } else if (!strncmp(name, "halt=", 5)) {
             if (atoi(val))
                 codec_action = CODEC_ACTION_HALT;
@@ -406,6 +729,8 @@ static void perform_config(void)
             ci.id3->offset = atoi(val);
         } else if (!strncmp(name, "rate=", 5)) {
             dsp_set_pitch(atof(val) * PITCH_SPEED_100);
+        } else if (!strncmp(name, "resample=", 9)) {
+            dsp_resample_sinc_enable(atoi(val) ? true : false);
         } else if (!strncmp(name, "seek=", 5)) {
             codec_action = CODEC_ACTION_SEEK_TIME;
             codec_action_param = atoi(val);
@@ -438,6 +763,7 @@ static void *ci_codec_get_buffer(size_t *size)
 
 static void ci_pcmbuf_insert(const void *ch1, const void *ch2, int count)
 {
+    uint64_t start = mode == MODE_BENCH ? now_ns() : 0;
     num_output_samples += count;
 
     if (use_dsp) {
@@ -455,7 +781,13 @@ static void ci_pcmbuf_insert(const void *ch1, const void *ch2, int count)
             dst.p16out = buf;
             dst.bufcount = out_count;
 
-            dsp_process(ci.dsp, &src, &dst);
+            if (mode == MODE_BENCH) {
+                uint64_t dsp_start = now_ns();
+                dsp_process(ci.dsp, &src, &dst);
+                bench_dsp_ns += now_ns() - dsp_start;
+            } else {
+                dsp_process(ci.dsp, &src, &dst);
+            }
 
             if (dst.remcount > 0) {
                 if (mode == MODE_WRITE)
@@ -497,6 +829,9 @@ static void ci_pcmbuf_insert(const void *ch1, const void *ch2, int count)
             write_pcm_raw(buf, count);
     }
 
+    if (mode == MODE_BENCH)
+        bench_record_insert(now_ns() - start);
+
     perform_config();
 }
 
@@ -591,13 +926,13 @@ static void ci_set_offset(size_t value)
 
 static void ci_configure(int setting, intptr_t value)
 {
+    if (setting == DSP_SET_FREQUENCY)
+        format.freq = value;
+
     if (use_dsp) {
         dsp_configure(ci.dsp, setting, value);
     } else {
-        if (setting == DSP_SET_FREQUENCY
-                || setting == DSP_SET_FREQUENCY)
-            format.freq = value;
-        else if (setting == DSP_SET_SAMPLE_DEPTH)
+        if (setting == DSP_SET_SAMPLE_DEPTH)
             format.depth = value;
         else if (setting == DSP_SET_STEREO_MODE) {
             format.stereo_mode = value;
@@ -756,13 +1091,18 @@ static void print_mp3entry(const struct mp3entry *id3, FILE *f)
 
 static void decode_file(const char *input_fn)
 {
-    /* Initialize DSP before any sort of interaction */
-    dsp_init();
-
-    /* Set up global settings */
-    memset(&global_settings, 0, sizeof(global_settings));
-    global_settings.timestretch_enabled = true;
-    dsp_timestretch_enable(true);
+    /* Initialize DSP before any sort of interaction; this is done once since
+       benchmark mode decodes several files in a row */
+    static bool dsp_initialized = false;
+    if (!dsp_initialized) {
+        dsp_init();
+
+        /* Set up global settings */
+        memset(&global_settings, 0, sizeof(global_settings));
+        global_settings.timestretch_enabled = true;
+        dsp_timestretch_enable(true);
+        dsp_initialized = true;
+    }
 
     /* Open file */
     if (!strcmp(input_fn, "-")) {
@@ -781,7 +1121,8 @@ static void decode_file(const char *input_fn)
         fprintf(stderr, "error: metadata parsing failed\n");
         exit(1);
     }
-    print_mp3entry(&id3, stderr);
+    if (mode != MODE_BENCH)
+        print_mp3entry(&id3, stderr);
     ci.filesize = filesize(input_fd);
     ci.id3 = &id3;
     if (use_dsp) {
@@ -790,6 +1131,11 @@ static void decode_file(const char *input_fn)
         dsp_configure(ci.dsp, DSP_RESET, 0);
         dsp_dither_enable(false);
     }
+    format.freq = id3.frequency;
+    num_output_samples = 0;
+    codec_action = CODEC_ACTION_NULL;
+    enable_loop = false;
+    config = config_arg;
     perform_config();
 
     /* Load codec */
@@ -822,9 +1168,14 @@ static void decode_file(const char *input_fn)
         fprintf(stderr, "error: codec returned error from codec_main\n");
         exit(1);
     }
+    if (mode == MODE_BENCH)
+        bench_reset();
+    uint64_t decode_start = now_ns();
     if (c_hdr->run_proc() != CODEC_OK) {
         fprintf(stderr, "error: codec error\n");
     }
+    if (mode == MODE_BENCH)
+        bench_report(input_fn, format.freq, now_ns() - decode_start);
     c_hdr->entry_point(CODEC_UNLOAD);
 
     /* Close */
@@ -838,21 +1189,35 @@ static void print_help(const char *progname)
     fprintf(stderr, "Usage:\n"
                     "        Play: %s [options] INPUTFILE\n"
                     "Write to WAV: %s [options] INPUTFILE OUTPUTFILE\n"
+                    "   Benchmark: %s -b [options] INPUTFILE...\n"
+                    "  Self-check: %s -t\n"
                     "\n"
                     "general options:\n"
                     "  -c a=1:b=2    Configuration (see below)\n"
                     "  -h            Show this help\n"
                     "\n"
+                    "self-check options:\n"
+                    "  -t            Check the vectorized DSP stages against\n"
+                    "                the C code and exit\n"
+                    "\n"
+                    "benchmark options:\n"
+                    "  -b            Decode each file with output discarded and\n"
+                    "                print timings as one JSON line per file\n"
+                    "\n"
                     "write to WAV options:\n"
                     "  -f            Write raw codec output converted to 64-bit float\n"
                     "  -r            Write raw 32-bit codec output without WAV header\n"
                     "\n"
                     "configuration:\n"
+                    "  compressor=<n> Compress above <n> dB, e.g. -12 [0 = off]\n"
+                    "  crossfeed=<n> Crossfeed type: 0 off, 1 Meier, 2 custom [0]\n"
                     "  dither=<0|1>  Enable/disable dithering [0]\n"
+                    "  eq=<n>        Set all equalizer bands to <n> dB [0 = off]\n"
                     "  halt=<0|1>    Stop decoding if 1 [0]\n"
                     "  loop=<0|1>    Enable/disable looping [0]\n"
                     "  offset=<n>    Start at byte offset within the file [0]\n"
                     "  rate=<n>      Multiply rate by <n> [1.0]\n"
+                    "  resample=<0|1> Use the windowed-sinc resampler [0]\n"
                     "  seek=<n>      Seek <n> ms into the file\n"
                     "  tempo=<n>     Timestretch by <n> [1.0]\n"
                     "  vol=<n>       Set volume attenuation to <n> dB [-0]\n"
@@ -864,16 +1229,23 @@ static void print_help(const char *progname)
                     "  %s in.adx -c loop=1:wait=44100:halt=1\n"
                     "  # Lower pitch 1 octave and write to out.wav\n"
                     "  %s in.ogg -c rate=0.5:tempo=2 out.wav\n"
-                    , progname, progname, progname, progname);
+                    "  # Measure decode and timestretch cost over several files\n"
+                    "  %s -b -c tempo=1.5 *.flac > results.jsonl\n"
+                    , progname, progname, progname, progname, progname, progname,
+                    progname);
 }
 
 int main(int argc, char **argv)
 {
     int opt;
-    while ((opt = getopt(argc, argv, "c:fhr")) != -1) {
+    bool bench = false;
+    while ((opt = getopt(argc, argv, "bc:fhrt")) != -1) {
         switch (opt) {
+        case 'b':
+            bench = true;
+            break;
         case 'c':
-            config = optarg;
+            config_arg = optarg;
             break;
         case 'f':
             use_dsp = false;
@@ -882,6 +1254,9 @@ int main(int argc, char **argv)
             use_dsp = false;
             write_raw = true;
             break;
+        case 't':
+            mode = MODE_CHECK;
+            break;
         case 'h': /* fallthrough */
         default:
             print_help(argv[0]);
@@ -889,7 +1264,18 @@ int main(int argc, char **argv)
         }
     }
 
-    if (argc == optind + 2) {
+    if (mode == MODE_CHECK) {
+        core_allocator_init();
+        return self_check() ? 1 : 0;
+    } else if (bench && argc > optind) {
+        if (write_raw) {
+            fprintf(stderr, "error: -r can't be used for benchmarking\n");
+            print_help(argv[0]);
+            exit(1);
+        }
+        core_allocator_init();
+        bench_init();
+    } else if (argc == optind + 2) {
         write_init(argv[optind + 1]);
     } else if (argc == optind + 1) {
         if (!use_dsp) {
@@ -906,7 +1292,12 @@ int main(int argc, char **argv)
         exit(1);
     }
 
-    decode_file(argv[optind]);
+    if (mode == MODE_BENCH) {
+        for (int i = optind; i < argc; i++)
+            decode_file(argv[i]);
+    } else {
+        decode_file(argv[optind]);
+    }
 
     if (mode == MODE_WRITE)
         write_quit();
@@ -266,38 +266,72 @@ static const struct tag_info legal_tags[] =
 /* A table of legal escapable characters */
 static const char legal_escape_characters[] = "%(,);#<|>";
 
+#define TAG_COUNT (sizeof(legal_tags)/sizeof(*legal_tags) - 1) /* no end marker */
+
 /*
- * Just does a straight search through the tag table to find one by
- * the given name, n denotes command length and length name will be truncated to
+ * Tag names are at most MAX_TAG_LENGTH-1 chars so they are packed into an
+ * integer key (first char in the top byte) and the table is indexed by key
+ * the first time a tag is looked up. Lookups are then a binary search per
+ * length instead of a scan of the whole table.
  */
-static const struct tag_info* search_tag(const char* name, int n)
-{
-    const struct tag_info* current = legal_tags;
-
-    /*
-     * Continue searching so long as we have a non-empty name string
-     * and the name of the current element doesn't match the name
-     * we're searching for, param_pos contains the length of name
-     * including the Null \0 character
-     */
+static unsigned long tag_keys[TAG_COUNT];
+static unsigned short tag_index[TAG_COUNT];
+static int tag_index_ready = 0;
 
-    while(current->param_pos > 1
-      && (current->param_pos != n || strncmp(current->name, name, n - 1) != 0))
+static unsigned long tag_key(const char* name, int len)
+{
+    unsigned long key = 0;
+    int i;
+    for (i = 0; i < MAX_TAG_LENGTH - 1; i++)
     {
-        current++;
+        key <<= 8;
+        if (i < len)
+            key |= (unsigned char)name[i];
     }
+    return key;
+}
 
-    if(current->param_pos <= 1) /*param_pos of 1 is an empty string '\0'*/
+static void build_tag_index(void)
+{
+    unsigned int i;
+    for (i = 0; i < TAG_COUNT; i++)
     {
-        //DEBUGF("!NOT FOUND! %s %d %.*s\n", __func__, -1, n-1, name);
-        return NULL;
+        unsigned long key = tag_key(legal_tags[i].name,
+                                    legal_tags[i].param_pos - 1);
+        unsigned int j = i;
+        /* insertion sort, the table is only a couple of hundred entries */
+        while (j > 0 && tag_keys[j - 1] > key)
+        {
+            tag_keys[j] = tag_keys[j - 1];
+            tag_index[j] = tag_index[j - 1];
+            j--;
+        }
+        tag_keys[j] = key;
+        tag_index[j] = i;
     }
-    else
+    tag_index_ready = 1;
+}
+
+/*
+ * Binary search of the tag index for the tag named by the first len
+ * characters of name
+ */
+static const struct tag_info* search_tag(const char* name, int len)
+{
+    unsigned long key = tag_key(name, len);
+    unsigned int low = 0, high = TAG_COUNT;
+
+    while (low < high)
     {
-        //DEBUGF("%s %d %s\n", __func__, current->type, current->name);
-        return current;
+        unsigned int mid = (low + high) / 2;
+        if (tag_keys[mid] < key)
+            low = mid + 1;
+        else if (tag_keys[mid] > key)
+            high = mid;
+        else
+            return &legal_tags[tag_index[mid]];
     }
-
+    return NULL;
 }
 
 /* Searches through the legal escape characters string */
@@ -321,11 +355,18 @@ const struct tag_info* find_tag(const char *name)
 {
     /* First we check three then two characters after the '%', then a single char */
     const struct tag_info *tag = NULL;
-    int i = MAX_TAG_LENGTH;
-    while (!tag && i > 1)
+    int len = 0;
+
+    if (!tag_index_ready)
+        build_tag_index();
+
+    /* don't look past the end of the document */
+    while (len < MAX_TAG_LENGTH - 1 && name[len])
+        len++;
+    while (!tag && len > 0)
     {
-        tag = search_tag(name, i);
-        i--;
+        tag = search_tag(name, len);
+        len--;
     }
     return tag;
 }
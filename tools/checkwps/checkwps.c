@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "config.h"
 #include "checkwps.h"
 #include "resize.h"
@@ -256,6 +257,8 @@ int main(int argc, char **argv)
     int ret = 0;
     int res;
     int filearg = 1;
+    int bench_loops = 0;
+    double bench_total = 0;
 
     struct wps_data wps={0};
     enum screen_type screen = SCREEN_MAIN;
@@ -272,14 +275,21 @@ int main(int argc, char **argv)
         printf("\t-v\t\tverbose\n");
         printf("\t-vv\t\tmore verbose\n");
         printf("\t-vvv\t\tvery verbose\n");
+        printf("\t-b[N]\t\tbenchmark, parse every skin N (100) times\n");
         printf("\t-h,\t--help\tshow this message\n");
         return 1;
     }
 
-    if (argv[1][0] == '-') {
-        filearg++;
+    while (argv[filearg] && argv[filearg][0] == '-') {
+        const char *opt = argv[filearg++];
+        if (opt[1] == 'b') {
+            bench_loops = opt[2] ? atoi(&opt[2]) : 100;
+            if (bench_loops < 1)
+                bench_loops = 1;
+            continue;
+        }
         int i = 1;
-        while (argv[1][i] && argv[1][i] == 'v') {
+        while (opt[i] && opt[i] == 'v') {
             i++;
             wps_verbose_level++;
             debug_wps = true;
@@ -338,11 +348,23 @@ int main(int argc, char **argv)
             goto done;
         }
 
+        if (bench_loops) {
+            clock_t start = clock();
+            for (int i = 0; i < bench_loops && res; i++)
+                res = skin_data_load(screen, &wps, name, true, &stats);
+            double ms = (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+            bench_total += ms;
+            printf("%d loads: %.3f ms per load\n", bench_loops, ms / bench_loops);
+        }
+
         printf("WPS parsed OK\n\n");
         if (wps_verbose_level>2)
             skin_debug_tree(SKINOFFSETTOPTR(skin_buffer, wps.tree));
     }
 
+    if (bench_loops)
+        printf("Total parse time: %.3f ms\n", bench_total);
+
 done:
     if (skin_buffer)
         free(skin_buffer);
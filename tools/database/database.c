@@ -2,22 +2,89 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include <time.h>
 
 #include "config.h"
 #include "tagcache.h"
 #include "dir.h"
+#include "metadata.h"
+#define METADATA_STREAM_NO_REDIRECT
+#include "metadata_stream.h"
 
 /* This is meant to be run on the root of the dap. it'll put the db files into
  * a .rockbox subdir */
 
+static int default_jobs(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0)
+        return cpus;
+#endif
+    return 1;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-j jobs]\n", name);
+    fprintf(stderr, "       %s -b file...\n", name);
+    fprintf(stderr, "  -j jobs  number of processes parsing metadata "
+                    "(default: one per cpu)\n");
+    fprintf(stderr, "  -b       time metadata parsing of the given files "
+                    "(paths from the DAP's top-level directory)\n");
+}
+
+/* Time get_metadata() over a set of files */
+static int benchmark(int count, char **files)
+{
+    static struct mp3entry id3;
+    unsigned long fs_reads = metadata_stream_fs_reads();
+    int failed = 0;
+    clock_t start = clock();
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!get_metadata(&id3, -1, files[i]))
+        {
+            fprintf(stderr, "failed: %s\n", files[i]);
+            failed++;
+        }
+    }
+
+    double ms = (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+    fs_reads = metadata_stream_fs_reads() - fs_reads;
+    printf("%d files (%d failed): %.3f ms, %.3f ms per file, "
+           "%.1f filesystem reads per file\n", count, failed, ms,
+           count ? ms / count : 0, count ? (double)fs_reads / count : 0);
+    return failed ? 2 : 0;
+}
+
 int main(int argc, char **argv)
 {
-    (void)argc;
-    (void)argv;
+    int jobs = default_jobs();
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            jobs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-b"))
+            return benchmark(argc - i - 1, &argv[i + 1]);
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
 
     fprintf(stderr, "Rockbox database tool for '%s'\n\n", TARGET_NAME);
 
@@ -33,6 +100,7 @@ int main(int argc, char **argv)
      * (with the help of sim_root_dir below */
     const char *paths[] = { "/", NULL };
     tagcache_init();
+    tagcache_set_build_jobs(jobs);
 
     fprintf(stderr, "Scanning files (make take some time)...");
 